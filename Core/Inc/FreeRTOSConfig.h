@@ -51,6 +51,8 @@
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
   #include <stdint.h>
   extern uint32_t SystemCoreClock;
+  void PreSleepProcessing(uint32_t *ulExpectedIdleTime);
+  void PostSleepProcessing(uint32_t *ulExpectedIdleTime);
 #endif
 #define configENABLE_FPU                         0
 #define configENABLE_MPU                         0
@@ -60,6 +62,7 @@
 #define configSUPPORT_DYNAMIC_ALLOCATION         1
 #define configUSE_IDLE_HOOK                      0
 #define configUSE_TICK_HOOK                      0
+#define configUSE_TICKLESS_IDLE                  1
 #define configCPU_CLOCK_HZ                       ( SystemCoreClock )
 #define configTICK_RATE_HZ                       ((TickType_t)1000)
 #define configMAX_PRIORITIES                     ( 56 )
@@ -142,6 +145,14 @@ to all Cortex-M ports, and do not rely on any particular library functions. */
 See http://www.FreeRTOS.org/RTOS-Cortex-M3-M4.html. */
 #define configMAX_SYSCALL_INTERRUPT_PRIORITY 	( configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY << (8 - configPRIO_BITS) )
 
+/* The configPRE_SLEEP_PROCESSING() and configPOST_SLEEP_PROCESSING() macros
+allow the application writer to add additional code before and after the MCU is
+placed into the low power state respectively. */
+#if configUSE_TICKLESS_IDLE == 1
+#define configPRE_SLEEP_PROCESSING                        PreSleepProcessing
+#define configPOST_SLEEP_PROCESSING                       PostSleepProcessing
+#endif /* configUSE_TICKLESS_IDLE == 1 */
+
 /* Normal assert() semantics without relying on the provision of an assert.h
 header file. */
 /* USER CODE BEGIN 1 */
@@ -160,6 +171,22 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+/* Scheduler instrumentation, kept in freertos.c */
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+  extern volatile uint32_t sched_context_switches;
+  extern volatile uint32_t sched_sleeps;
+  extern volatile uint8_t sched_stay_awake;
+  extern volatile uint8_t sched_stay_awake_net;
+  void sched_switched_in(void);
+  void sched_switched_out(uint32_t idle);
+  uint64_t sched_busy_cycles_get(void);
+#endif
+/* Expanded in tasks.c, where the idle task's handle is in scope */
+#define traceTASK_SWITCHED_IN()     sched_switched_in()
+#define traceTASK_SWITCHED_OUT()    sched_switched_out(pxCurrentTCB == xIdleTaskHandle)
+/* The DWT cycle counter stops in sleep: keep ticking while a test relies on it */
+#define configPRE_SUPPRESS_TICKS_AND_SLEEP_PROCESSING(x)  \
+  do { if (sched_stay_awake || sched_stay_awake_net) { (x) = 0; } } while (0)
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -41,6 +41,14 @@ extern "C" {
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
+/* Transport a command arrived on, its result goes back the same way */
+#define CMD_ORIGIN_UDP      0
+#define CMD_ORIGIN_TCP      1
+
+/* command_submit outcomes */
+#define CMD_SUBMIT_OK       0
+#define CMD_SUBMIT_REFUSED  (-1)    // Over the client's share, queue full or no memory; TEST_ERR
+#define CMD_SUBMIT_LATE     (-2)    // The test would miss its deadline; TEST_DEADLINE
 
 /* USER CODE END EC */
 
@@ -53,6 +61,7 @@ extern "C" {
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
+int command_submit(const void *cmd, const void *sched, uint8_t session, uint32_t tag, uint32_t wait);
 
 /* USER CODE END EFP */
 
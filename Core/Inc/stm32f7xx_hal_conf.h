@@ -214,6 +214,8 @@
 #define ETH_TX_BUF_SIZE                ETH_MAX_PACKET_SIZE /* buffer size for transmit              */
 #define ETH_RXBUFNB                    ((uint32_t)4U)       /* 4 Rx buffers of size ETH_RX_BUF_SIZE  */
 #define ETH_TXBUFNB                    ((uint32_t)4U)       /* 4 Tx buffers of size ETH_TX_BUF_SIZE  */
+#define ETH_TX_DESC_CNT                4U                   /* number of Ethernet Tx DMA descriptors */
+#define ETH_RX_DESC_CNT                8U                   /* number of Ethernet Rx DMA descriptors */
 
 /* Section 2: PHY configuration section */
 
@@ -78,6 +78,9 @@ void SPI4_IRQHandler(void);
 void I2C4_EV_IRQHandler(void);
 void I2C4_ER_IRQHandler(void);
 /* USER CODE BEGIN EFP */
+void DMA2_Stream4_IRQHandler(void);
+void DMA2_Stream6_IRQHandler(void);
+void DMA2_Stream7_IRQHandler(void);
 
 /* USER CODE END EFP */
 
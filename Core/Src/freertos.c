@@ -44,6 +44,12 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN Variables */
+volatile uint32_t sched_context_switches;   // Scheduler switch-ins since boot
+volatile uint32_t sched_sleeps;             // Tickless sleeps entered since boot
+volatile uint8_t sched_stay_awake;          // Set while a test is timing with the DWT counter
+volatile uint8_t sched_stay_awake_net;      // Same, for a network benchmark in the tcpip thread
+static uint64_t sched_busy_cycles;          // DWT cycles spent in tasks other than idle
+static uint32_t sched_switch_cycles;        // DWT stamp of the last switch-in
 
 /* USER CODE END Variables */
 
@@ -52,8 +58,56 @@
 
 /* USER CODE END FunctionPrototypes */
 
+/* Pre/Post sleep processing prototypes */
+void PreSleepProcessing(uint32_t *ulExpectedIdleTime);
+void PostSleepProcessing(uint32_t *ulExpectedIdleTime);
+
+/* USER CODE BEGIN PREPOSTSLEEP */
+void PreSleepProcessing(uint32_t *ulExpectedIdleTime)
+{
+  /* Stop the 1 ms HAL timebase so it does not wake the core every tick */
+  HAL_SuspendTick();
+  sched_sleeps++;
+}
+
+void PostSleepProcessing(uint32_t *ulExpectedIdleTime)
+{
+  HAL_ResumeTick();
+}
+/* USER CODE END PREPOSTSLEEP */
+
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
+/* Called by the scheduler with interrupts masked, keep them short */
+void sched_switched_in(void)
+{
+  sched_context_switches++;
+  sched_switch_cycles = DWT->CYCCNT;
+}
+
+void sched_switched_out(uint32_t idle)
+{
+  /* Only idle sleeps, so busy time is exact even though the counter stops in sleep */
+  if (!idle)
+  {
+    sched_busy_cycles += DWT->CYCCNT - sched_switch_cycles;
+  }
+}
+
+/**
+  * @brief  CPU cycles spent outside the idle task since boot. CPU load over
+  *         an interval is the difference of two readings over its length.
+  */
+uint64_t sched_busy_cycles_get(void)
+{
+  uint64_t cycles;
+
+  taskENTER_CRITICAL();
+  /* The running task's share so far counts too */
+  cycles = sched_busy_cycles + (DWT->CYCCNT - sched_switch_cycles);
+  taskEXIT_CRITICAL();
+  return cycles;
+}
 
 /* USER CODE END Application */
 
@@ -27,6 +27,9 @@
 #include <stdarg.h>
 
 #include "lwip/udp.h"
+#include "lwip/stats.h"
+#include "lwip/igmp.h"
+#include "lwip/timeouts.h"
 
 #include "FreeRTOS.h"
 #include "semphr.h" // For semaphore-specific functions and types like SemaphoreHandle_t
@@ -37,11 +40,41 @@
 #include "spis.h"
 #include "adcs.h"
 #include "timer_test.h"
+#include "heap_tlsf.h"
+#include "tcp_channel.h"
+#include "cmd_sessions.h"
+#include "result_cache.h"
+#include "mqtt_telemetry.h"
+#include "iperf_server.h"
+#include "test_abort.h"
+#include "cmd_sched.h"
 
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
+typedef StaticTask_t osStaticThreadDef_t;
+typedef StaticQueue_t osStaticMessageQDef_t;
+typedef StaticSemaphore_t osStaticSemaphoreDef_t;
 /* USER CODE BEGIN PTD */
+/* What testsQ and probeQ carry a pointer to: the command and where its result goes */
+typedef struct queued_command_t {
+    test_command_t cmd;     // First, the tests take it as a test_command_t*
+    uint8_t session;        // Client the result goes back to, index into cmd_sessions
+    uint32_t tag;           // Handed back to the transport with the result
+    Result control_result;  // Control commands: the answer, decided on arrival
+    cmd_sched_entry_t sched;    // Tests: class, deadline and place in the run order
+    uint32_t submitted_cycles;  // Queries: DWT stamp of the hand-off
+} queued_command_t;
+
+/* A fleet result held back by its reply delay, sent from the tcpip thread */
+typedef struct deferred_reply_t {
+    struct deferred_reply_t *next;  // Due later, the list is in due order
+    uint32_t due;           // sys_now() it goes out at
+    uint8_t session;
+    uint32_t tag;
+    result_pro_t result;
+    test_report_t report;
+} deferred_reply_t;
 
 /* USER CODE END PTD */
 
@@ -54,6 +87,8 @@ extern struct netif gnetif;
 /* Private macro -------------------------------------------------------------*/
 /* USER CODE BEGIN PM */
 #define LOCAL_PORT   5005
+#define CMDQ_DEPTH   16     // testsQ length, each client holds at most an equal share
+#define PROBEQ_DEPTH 8      // probeQ length, aborts and queries
 
 /* USER CODE END PM */
 
@@ -86,80 +121,129 @@ DMA_HandleTypeDef hdma_usart2_tx;
 
 PCD_HandleTypeDef hpcd_USB_OTG_FS;
 
-/* Definitions for defaultTask */
-osThreadId_t defaultTaskHandle;
-const osThreadAttr_t defaultTask_attributes = {
-  .name = "defaultTask",
-  .stack_size = 1024 * 4,
-  .priority = (osPriority_t) osPriorityNormal,
+/* Definitions for performing_task */
+osThreadId_t performing_taskHandle;
+uint32_t performing_taskBuffer[ 2048 ];
+osStaticThreadDef_t performing_taskControlBlock;
+const osThreadAttr_t performing_task_attributes = {
+  .name = "performing_task",
+  .cb_mem = &performing_taskControlBlock,
+  .cb_size = sizeof(performing_taskControlBlock),
+  .stack_mem = &performing_taskBuffer[0],
+  .stack_size = sizeof(performing_taskBuffer),
+  .priority = (osPriority_t) osPriorityHigh,
 };
 /* Definitions for blink_task */
 osThreadId_t blink_taskHandle;
+uint32_t blink_taskBuffer[ 1024 ];
+osStaticThreadDef_t blink_taskControlBlock;
 const osThreadAttr_t blink_task_attributes = {
   .name = "blink_task",
-  .stack_size = 1024 * 4,
+  .cb_mem = &blink_taskControlBlock,
+  .cb_size = sizeof(blink_taskControlBlock),
+  .stack_mem = &blink_taskBuffer[0],
+  .stack_size = sizeof(blink_taskBuffer),
   .priority = (osPriority_t) osPriorityLow,
 };
-/* Definitions for udp_task */
-osThreadId_t udp_taskHandle;
-const osThreadAttr_t udp_task_attributes = {
-  .name = "udp_task",
-  .stack_size = 1024 * 4,
-  .priority = (osPriority_t) osPriorityLow,
-};
-/* Definitions for performing_task */
-osThreadId_t performing_taskHandle;
-const osThreadAttr_t performing_task_attributes = {
-  .name = "performing_task",
-  .stack_size = 2048 * 4,
-  .priority = (osPriority_t) osPriorityHigh,
-};
 /* Definitions for testsQ */
 osMessageQueueId_t testsQHandle;
+uint8_t testsQBuffer[ 16 * 4 ];
+osStaticMessageQDef_t testsQControlBlock;
 const osMessageQueueAttr_t testsQ_attributes = {
-  .name = "testsQ"
+  .name = "testsQ",
+  .cb_mem = &testsQControlBlock,
+  .cb_size = sizeof(testsQControlBlock),
+  .mq_mem = &testsQBuffer,
+  .mq_size = sizeof(testsQBuffer)
 };
 /* Definitions for UartRx */
 osSemaphoreId_t UartRxHandle;
+osStaticSemaphoreDef_t UartRxControlBlock;
 const osSemaphoreAttr_t UartRx_attributes = {
-  .name = "UartRx"
+  .name = "UartRx",
+  .cb_mem = &UartRxControlBlock,
+  .cb_size = sizeof(UartRxControlBlock),
 };
 /* Definitions for UartTx */
 osSemaphoreId_t UartTxHandle;
+osStaticSemaphoreDef_t UartTxControlBlock;
 const osSemaphoreAttr_t UartTx_attributes = {
-  .name = "UartTx"
+  .name = "UartTx",
+  .cb_mem = &UartTxControlBlock,
+  .cb_size = sizeof(UartTxControlBlock),
 };
 /* Definitions for I2cRx */
 osSemaphoreId_t I2cRxHandle;
+osStaticSemaphoreDef_t I2cRxControlBlock;
 const osSemaphoreAttr_t I2cRx_attributes = {
-  .name = "I2cRx"
+  .name = "I2cRx",
+  .cb_mem = &I2cRxControlBlock,
+  .cb_size = sizeof(I2cRxControlBlock),
 };
 /* Definitions for I2cTx */
 osSemaphoreId_t I2cTxHandle;
+osStaticSemaphoreDef_t I2cTxControlBlock;
 const osSemaphoreAttr_t I2cTx_attributes = {
-  .name = "I2cTx"
+  .name = "I2cTx",
+  .cb_mem = &I2cTxControlBlock,
+  .cb_size = sizeof(I2cTxControlBlock),
 };
 /* Definitions for SpiRx */
 osSemaphoreId_t SpiRxHandle;
+osStaticSemaphoreDef_t SpiRxControlBlock;
 const osSemaphoreAttr_t SpiRx_attributes = {
-  .name = "SpiRx"
+  .name = "SpiRx",
+  .cb_mem = &SpiRxControlBlock,
+  .cb_size = sizeof(SpiRxControlBlock),
 };
 /* Definitions for AdcSem */
 osSemaphoreId_t AdcSemHandle;
+osStaticSemaphoreDef_t AdcSemControlBlock;
 const osSemaphoreAttr_t AdcSem_attributes = {
-  .name = "AdcSem"
+  .name = "AdcSem",
+  .cb_mem = &AdcSemControlBlock,
+  .cb_size = sizeof(AdcSemControlBlock),
 };
 /* Definitions for TimSem */
 osSemaphoreId_t TimSemHandle;
+osStaticSemaphoreDef_t TimSemControlBlock;
 const osSemaphoreAttr_t TimSem_attributes = {
-  .name = "TimSem"
+  .name = "TimSem",
+  .cb_mem = &TimSemControlBlock,
+  .cb_size = sizeof(TimSemControlBlock),
 };
 /* Definitions for SpiSlaveRx */
 osSemaphoreId_t SpiSlaveRxHandle;
+osStaticSemaphoreDef_t SpiSlaveRxControlBlock;
 const osSemaphoreAttr_t SpiSlaveRx_attributes = {
-  .name = "SpiSlaveRx"
+  .name = "SpiSlaveRx",
+  .cb_mem = &SpiSlaveRxControlBlock,
+  .cb_size = sizeof(SpiSlaveRxControlBlock),
 };
 /* USER CODE BEGIN PV */
+/* Definitions for probe_task, answers aborts and queries while a test runs */
+osThreadId_t probe_taskHandle;
+uint32_t probe_taskBuffer[ 1024 ];
+osStaticThreadDef_t probe_taskControlBlock;
+const osThreadAttr_t probe_task_attributes = {
+  .name = "probe_task",
+  .cb_mem = &probe_taskControlBlock,
+  .cb_size = sizeof(probe_taskControlBlock),
+  .stack_mem = &probe_taskBuffer[0],
+  .stack_size = sizeof(probe_taskBuffer),
+  .priority = (osPriority_t) osPriorityHigh1,
+};
+/* Definitions for probeQ */
+osMessageQueueId_t probeQHandle;
+uint8_t probeQBuffer[ PROBEQ_DEPTH * 4 ];
+osStaticMessageQDef_t probeQControlBlock;
+const osMessageQueueAttr_t probeQ_attributes = {
+  .name = "probeQ",
+  .cb_mem = &probeQControlBlock,
+  .cb_size = sizeof(probeQControlBlock),
+  .mq_mem = &probeQBuffer,
+  .mq_size = sizeof(probeQBuffer)
+};
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -178,10 +262,8 @@ static void MX_TIM7_Init(void);
 static void MX_UART4_Init(void);
 static void MX_DAC_Init(void);
 static void MX_SPI4_Init(void);
-void lwip_initiation(void *argument);
-void blinking_blue(void *argument);
-void udp_function(void *argument);
 void perform_tests(void *argument);
+void blinking_blue(void *argument);
 
 /* USER CODE BEGIN PFP */
 
@@ -190,15 +272,59 @@ void udp_receive_init(void);
 void udp_receive_callback(void *arg, struct udp_pcb *pcb,
                           struct pbuf *p, const ip_addr_t *addr, u16_t port);
 int send_response(result_pro_t result);
-uint32_t calculate_crc(uint8_t *data, size_t length);
+int send_report(result_pro_t result, const test_report_t *report);
+static int command_reply(uint8_t session_index, uint32_t tag, uint8_t more, result_pro_t result, const test_report_t *report);
+static int command_deliver(uint8_t session_index, uint32_t tag, uint8_t more, result_pro_t result, const test_report_t *report);
+static void executor_collect(void);
+static Result run_query(const test_command_t *cmd, test_report_t *report);
+static void answer_control(queued_command_t *queued);
+static void answer_held_aborts(void);
+void answer_probes(void *argument);
+static int udp_send_result(result_pro_t result, const test_report_t *report, const ip_addr_t *addr, u16_t port);
+#if LWIP_IGMP
+static uint32_t multicast_reply_delay(uint32_t test_id);
+static void command_reply_later(uint8_t session_index, uint32_t delay_ms, result_pro_t result, const test_report_t *report);
+static void command_reply_due(void *arg);
+#endif
+static void net_get_stats(net_stats_t *stats);
+static void netmem_get_stats(netmem_stats_t *stats);
+static void net_get_metrics(net_metrics_t *metrics);
+static void boot_mark_ready(void);
+static void sched_get_stats(sched_stats_t *stats);
 
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 
-ip_addr_t g_server_addr;
-u16_t g_server_port;
+static uint32_t boot_hsi_cycles;    // Cycles counted before the PLL was up
+static uint32_t boot_kernel_cycles; // Cycles at the scheduler start, the core has not slept yet
+static boot_stats_t boot_stats;
+
+static volatile uint8_t executor_waiting;           // Executor blocked with nothing queued
+static volatile uint8_t executor_notified;          // executor_notify_cycles woke it
+static volatile uint32_t executor_notify_cycles;    // DWT stamp of the hand-off that woke the executor
+static uint32_t executor_wake_cycles_last;
+static uint32_t executor_wake_cycles_max;
+static uint32_t probe_wait_us_last, probe_wait_us_max;    // Query hand-off to probe_task running it
+
+#define RESPONSE_MAX_LENGTH  (sizeof(result_pro_t) + sizeof(((test_report_t *)0)->data))
+static struct pbuf *response_pbuf;  // Reused for every result unless lwIP still holds it
+static void *response_payload;      // Its payload before lwIP prepended any headers
+static uint32_t responses_sent, response_errors, response_allocs;
+static uint32_t response_cycles_max;
+static uint64_t response_cycles_total, response_alloc_cycles_total;
+
+// Command queue counters, only written from the tcpip thread or under its lock
+static uint32_t cmdq_enqueued, cmdq_full, cmdq_rejected, cmdq_quota, cmdq_depth_max;
+
+// Client of the command the executor is running, send_report answers there
+static uint8_t executing_session = CMD_SESSION_NONE;
+static uint32_t executing_tag;
+
+#if LWIP_IGMP
+static deferred_reply_t *deferred_replies;     // Fleet results not yet due, under the tcpip core lock
+#endif
 
 /* USER CODE END 0 */
 
@@ -210,6 +336,9 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
+  // Time-to-ready is measured from here, restart the counter on every reset
+  dwt_cycle_counter_init();
+  DWT->CYCCNT = 0;
 
   /* USER CODE END 1 */
 
@@ -226,6 +355,7 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+  boot_hsi_cycles = DWT->CYCCNT;
 
   /* USER CODE END SysInit */
 
@@ -296,27 +426,24 @@ int main(void)
 
   /* USER CODE BEGIN RTOS_QUEUES */
   /* add queues, ... */
+  probeQHandle = osMessageQueueNew (PROBEQ_DEPTH, sizeof(queued_command_t *), &probeQ_attributes);
   /* USER CODE END RTOS_QUEUES */
 
   /* Create the thread(s) */
-  /* creation of defaultTask */
-  defaultTaskHandle = osThreadNew(lwip_initiation, NULL, &defaultTask_attributes);
+  /* creation of performing_task */
+  performing_taskHandle = osThreadNew(perform_tests, NULL, &performing_task_attributes);
 
   /* creation of blink_task */
   blink_taskHandle = osThreadNew(blinking_blue, NULL, &blink_task_attributes);
 
-  /* creation of udp_task */
-  udp_taskHandle = osThreadNew(udp_function, NULL, &udp_task_attributes);
-
-  /* creation of performing_task */
-  performing_taskHandle = osThreadNew(perform_tests, NULL, &performing_task_attributes);
-
   /* USER CODE BEGIN RTOS_THREADS */
   /* add threads, ... */
+  probe_taskHandle = osThreadNew(answer_probes, NULL, &probe_task_attributes);
   /* USER CODE END RTOS_THREADS */
 
   /* USER CODE BEGIN RTOS_EVENTS */
   /* add events, ... */
+  boot_kernel_cycles = DWT->CYCCNT;
   /* USER CODE END RTOS_EVENTS */
 
   /* Start scheduler */
@@ -1000,6 +1127,20 @@ void udp_receive_init(void)
         return;
     }
     udp_recv(udp_pcb_handle, udp_receive_callback, NULL);
+
+#if LWIP_IGMP
+    // The pcb is bound to any address, so it also hears the fleet group
+    ip4_addr_t group;
+    if (ip4addr_aton(CMD_MULTICAST_GROUP, &group)) {
+        igmp_joingroup_netif(&gnetif, &group);
+    }
+#endif
+
+    // One response buffer with room for the headers, reused for every result
+    response_pbuf = pbuf_alloc(PBUF_TRANSPORT, RESPONSE_MAX_LENGTH, PBUF_RAM);
+    if (response_pbuf != NULL) {
+        response_payload = response_pbuf->payload;
+    }
 }
 
 /**
@@ -1012,44 +1153,252 @@ void udp_receive_init(void)
 void udp_receive_callback(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
 {
     if (p != NULL) {
-        // Copy the sender's IP address
-        ip_addr_copy(g_server_addr, *addr);
-        // Copy the sender's port
-        g_server_port = port;
+        // The sender's session, its results go back to it and no one else
+        uint8_t session = cmd_session_open(CMD_ORIGIN_UDP, addr, port);
 
-        if (p->len >= sizeof(test_command_t))
+        if (session == CMD_SESSION_NONE)
+        {
+        	cmdq_rejected++;
+        	result_pro_t response={NULL, TEST_ERR};
+        	udp_send_result(response, NULL, addr, port);
+        }
+        else if (p->len >= sizeof(test_command_t))
         {
-            test_command_t *cmd = (test_command_t *)pvPortMalloc(sizeof(test_command_t));
-            if (cmd != NULL)
+            const test_command_t *command = (const test_command_t *)p->payload;
+            uint32_t test_id = command->test_id;
+            uint32_t reply_delay = 0;
+            const result_pro_t *cached;
+            const test_report_t *cached_report;
+            const void *sched = NULL;
+            result_cache_state_t state = RESULT_CACHE_MISS;
+            int submitted;
+
+            // Queries and aborts act on the board as it is now, they are never replayed
+            if (command->peripheral != CMD_ABORT && (command->peripheral & PERIPHERAL_MASK) != SYSTEM_P)
             {
-			   // Copy the data from the pbuf payload to the allocated memory
-			   memcpy(cmd, p->payload, sizeof(test_command_t)); // Only copy the struct size
-
-	            // Send the POINTER to the newly allocated and copied* data to the queue
-	            if (xQueueSendToBack(testsQHandle, &cmd, 1) != pdPASS) // Pass address of pointer
-	            {
-	            	result_pro_t response={NULL, TEST_ERR};
-	            	send_response(response);
-	                vPortFree(cmd); // If send fails, free the allocated memory
-	            } else {
-	                // notify if successfully sent to queue
-	                xTaskNotifyGive(performing_taskHandle);
-	            }
+                state = result_cache_claim(addr, port, test_id, &cached, &cached_report);
             }
-            else{
-            	result_pro_t response={NULL, TEST_ERR};
-            	send_response(response);
+            switch (state)
+            {
+            case RESULT_CACHE_DONE:
+                // A resend after a lost result, answer without running the test again
+                udp_send_result(*cached, cached_report, addr, port);
+                break;
+            case RESULT_CACHE_IN_FLIGHT:
+                // The result of the queued command answers this copy too
+                break;
+            default:
+#if LWIP_IGMP
+                if (ip4_addr_ismulticast(ip4_current_dest_addr()))
+                {
+                    reply_delay = multicast_reply_delay(test_id);
+                }
+#endif
+                // Only the struct and its scheduling trailer are read, the rest is ignored
+                if (p->len >= sizeof(test_command_t) + sizeof(test_sched_t))
+                {
+                    sched = (const uint8_t *)p->payload + sizeof(test_command_t);
+                }
+                submitted = command_submit(p->payload, sched, session, reply_delay, 1);
+                if (submitted == CMD_SUBMIT_LATE)
+                {
+                	// Not run, a resend is judged again on its own arrival
+                	result_cache_release(addr, port, test_id);
+                	result_pro_t response={test_id, TEST_DEADLINE};
+                	udp_send_result(response, NULL, addr, port);
+                }
+                else if (submitted != CMD_SUBMIT_OK)
+                {
+                	result_cache_release(addr, port, test_id);
+                	result_pro_t response={NULL, TEST_ERR};
+                	udp_send_result(response, NULL, addr, port);
+                }
+                break;
             }
         } else {
+        	cmdq_rejected++;
         	result_pro_t response={NULL, TEST_ERR};
-        	send_response(response);
+        	udp_send_result(response, NULL, addr, port);
         }
         pbuf_free(p);
     }
-    else{
-    	result_pro_t response={NULL, TEST_ERR};
-    	send_response(response);
+}
+
+#if LWIP_IGMP
+/**
+ * @brief Picks how long this board holds back the result of a fleet command.
+ * @details Every board of the fleet gets the same command at the same moment.
+ * Spreading the delay by the chip's unique ID keeps their results from reaching
+ * the server in one burst; mixing in the test ID changes which boards share a
+ * slot from one command to the next.
+ * @return Delay in milliseconds, 0 to CMD_MULTICAST_JITTER_MS.
+ */
+static uint32_t multicast_reply_delay(uint32_t test_id)
+{
+    uint32_t h = HAL_GetUIDw0() ^ HAL_GetUIDw1() ^ HAL_GetUIDw2() ^ test_id;
+
+    h *= 2654435761U;
+    return (h >> 16) % (CMD_MULTICAST_JITTER_MS + 1);
+}
+
+/**
+ * @brief Holds a fleet result back by its reply delay without holding up the caller.
+ * @details Called from the executor or probe_task. The tcpip thread sends the
+ * result once the delay is over, the next command runs in the meantime. All
+ * held results share one timeout, armed for the earliest. Without memory to
+ * copy the result, the caller waits out the delay instead.
+ * @param delay_ms The command's tag, its reply delay.
+ */
+static void command_reply_later(uint8_t session_index, uint32_t delay_ms, result_pro_t result, const test_report_t *report)
+{
+    deferred_reply_t *reply = (deferred_reply_t *)pvPortMalloc(sizeof(deferred_reply_t));
+    deferred_reply_t **at;
+
+    if (reply == NULL)
+    {
+        osDelay(delay_ms);
+        command_reply(session_index, delay_ms, 0, result, report);
+        return;
+    }
+    reply->session = session_index;
+    reply->tag = delay_ms;
+    reply->result = result;
+    reply->report.length = (report != NULL) ? report->length : 0;
+    if (reply->report.length > 0)
+    {
+        memcpy(reply->report.data, report->data, reply->report.length);
+    }
+
+    LOCK_TCPIP_CORE();
+    reply->due = sys_now() + delay_ms;
+    for (at = &deferred_replies; *at != NULL && (int32_t)((*at)->due - reply->due) <= 0; at = &(*at)->next);
+    reply->next = *at;
+    *at = reply;
+    if (deferred_replies == reply)
+    {
+        // The new earliest, the timeout moves to it
+        sys_untimeout(command_reply_due, NULL);
+        sys_timeout(delay_ms, command_reply_due, NULL);
     }
+    UNLOCK_TCPIP_CORE();
+}
+
+/**
+ * @brief sys_timeout handler: sends the held fleet results that are due.
+ */
+static void command_reply_due(void *arg)
+{
+    deferred_reply_t *reply;
+    uint32_t now = sys_now();
+
+    while (deferred_replies != NULL && (int32_t)(deferred_replies->due - now) <= 0)
+    {
+        reply = deferred_replies;
+        deferred_replies = reply->next;
+        command_deliver(reply->session, reply->tag, 0, reply->result, &reply->report);
+        vPortFree(reply);
+    }
+    if (deferred_replies != NULL)
+    {
+        sys_timeout(deferred_replies->due - now, command_reply_due, NULL);
+    }
+}
+#endif
+
+/**
+ * @brief Copies a command and queues it: tests for the executor, aborts and
+ * queries for probe_task.
+ * @details Called from the tcpip thread or with the tcpip core lock held.
+ * @param cmd A full test_command_t.
+ * @param sched Its test_sched_t trailer, NULL when it had none.
+ * @param session The client's cmd_sessions index, where the result goes.
+ * @param tag Transport data handed back with the result.
+ * @param wait Ticks to wait for room in the queue.
+ * @return int CMD_SUBMIT_OK when queued, CMD_SUBMIT_LATE when the test would
+ * miss its deadline, CMD_SUBMIT_REFUSED when the client is over its share of
+ * testsQ, the queue is full or memory ran out.
+ */
+int command_submit(const void *cmd, const void *sched, uint8_t session, uint32_t tag, uint32_t wait)
+{
+    const test_command_t *command = (const test_command_t *)cmd;
+    uint8_t priority = cmd_sched_priority(command, (const test_sched_t *)sched);
+    osMessageQueueId_t queue = (priority < CMD_PRIORITY_HIGH) ? probeQHandle : testsQHandle;
+    Result control_result = TEST_ERR;
+    uint32_t target = 0;
+    queued_command_t *queued;
+    cmd_sched_entry_t entry;
+    UBaseType_t depth;
+
+    // An abort acts now, even if its answer then finds no room in testsQ
+    if (command->peripheral == CMD_ABORT)
+    {
+        if (command->bit_pattern_length >= sizeof(target))
+        {
+            memcpy(&target, command->bit_pattern, sizeof(target));
+        }
+        control_result = test_abort_request(session, target);
+    }
+
+    // A test that cannot make its deadline is refused before it takes a place
+    if (queue == testsQHandle && cmd_sched_admit(&entry, command, (const test_sched_t *)sched) != 0)
+    {
+        return CMD_SUBMIT_LATE;
+    }
+
+    if (cmd_session_admit(session, CMDQ_DEPTH) != 0)
+    {
+        cmdq_quota++;
+        return CMD_SUBMIT_REFUSED;
+    }
+
+    queued = (queued_command_t *)pvPortMalloc(sizeof(queued_command_t));
+    if (queued == NULL)
+    {
+        cmd_session_done(session);
+        cmdq_rejected++;
+        return CMD_SUBMIT_REFUSED;
+    }
+    memcpy(&queued->cmd, cmd, sizeof(test_command_t));
+    queued->session = session;
+    queued->tag = tag;
+    queued->control_result = control_result;
+    queued->submitted_cycles = DWT->CYCCNT;
+    if (queue == testsQHandle)
+    {
+        queued->sched = entry;
+        queued->sched.owner = queued;
+    }
+
+    // The queue holds the pointer, the task answering the command frees it
+    if (xQueueSendToBack(queue, &queued, wait) != pdPASS)
+    {
+        cmd_session_done(session);
+        cmdq_full++;
+        vPortFree(queued);
+        return CMD_SUBMIT_REFUSED;
+    }
+    cmdq_enqueued++;
+    if (queue == probeQHandle)
+    {
+        // probe_task blocks on its queue, no notification
+        return CMD_SUBMIT_OK;
+    }
+    cmd_sched_submitted(&queued->sched);
+
+    depth = uxQueueMessagesWaiting(testsQHandle) + cmd_sched_ready();
+    if (depth > cmdq_depth_max)
+    {
+        cmdq_depth_max = depth;
+    }
+    // One notification per queued command. Only the one that wakes a blocked
+    // executor is stamped, the rest wait for the running test, not for a wake
+    if (executor_waiting && !executor_notified)
+    {
+        executor_notify_cycles = DWT->CYCCNT;
+        executor_notified = 1;
+    }
+    xTaskNotifyGive(performing_taskHandle);
+    return CMD_SUBMIT_OK;
 }
 
 /**
@@ -1059,145 +1408,592 @@ void udp_receive_callback(void *arg, struct udp_pcb *pcb, struct pbuf *p, const
  */
 int send_response(result_pro_t result)
 {
-    // Check if we have a valid sender address
-    if (ip_addr_isany(&g_server_addr) == 0)
+    return send_report(result, NULL);
+}
+
+/**
+ * @brief Sends the test result followed by the test's report, if any.
+ * @details Called from the executor, for the test it is running.
+ * @param result The result structure containing Test-ID and Pass/Fail status.
+ * @param report Optional report appended after the result (NULL or empty for none).
+ * @return int 0 on success, -1 on failure.
+ */
+int send_report(result_pro_t result, const test_report_t *report)
+{
+    cmd_sched_entry_t *next;
+    uint8_t more;
+
+    // Hold a TCP segment back when the next test's result will join it soon.
+    // A long or unknown run time sends now, the result would wait for it.
+    // The executor is the only reader, the peeked test stays where it is
+    executor_collect();
+    next = cmd_sched_peek();
+    more = (next != NULL) && (((queued_command_t *)next->owner)->session == executing_session)
+        && next->estimate_ms != 0 && next->estimate_ms <= TCP_RESULT_HOLD_MS;
+    return command_reply(executing_session, executing_tag, more, result, report);
+}
+
+/**
+ * @brief Sends a result to the client that sent the command.
+ * @details Called from the executor or probe_task, the send is serialised
+ * with the tcpip thread by the core lock.
+ * @param session_index The command's cmd_sessions index.
+ * @param tag The tag the command was submitted with.
+ * @param more Non-zero when another result for the same TCP client follows.
+ * @return int 0 on success, -1 on failure.
+ */
+static int command_reply(uint8_t session_index, uint32_t tag, uint8_t more, result_pro_t result, const test_report_t *report)
+{
+    int status;
+
+    LOCK_TCPIP_CORE();
+    status = command_deliver(session_index, tag, more, result, report);
+    UNLOCK_TCPIP_CORE();
+    return status;
+}
+
+/**
+ * @brief command_reply() for a caller that holds the tcpip core lock.
+ */
+static int command_deliver(uint8_t session_index, uint32_t tag, uint8_t more, result_pro_t result, const test_report_t *report)
+{
+    cmd_session_t *session = &cmd_sessions[session_index];
+    int status;
+
+    if (session->origin == CMD_ORIGIN_TCP)
     {
-        // Create a new pbuf for the response data
-        struct pbuf* p = pbuf_alloc(PBUF_TRANSPORT, sizeof(result_pro_t), PBUF_RAM);
-        if (p != NULL)
+        status = tcp_channel_send_result(result, report, tag, more);
+    }
+    else
+    {
+        status = udp_send_result(result, report, &session->addr, session->port);
+        if (result.test_result == TEST_DEADLINE)
+        {
+            // Not run, a resend is judged again on its own arrival, as in udp_receive_callback()
+            result_cache_release(&session->addr, session->port, result.test_id);
+        }
+        else
         {
-            // Copy the result struct into the pbuf payload
-            memcpy(p->payload, &result, sizeof(result_pro_t));
+            // Kept even when the send failed, the client's resend is answered from it
+            result_cache_complete(&session->addr, session->port, result, report);
+        }
+    }
+#if MQTT_TELEMETRY
+    mqtt_telemetry_result(result, report);
+#endif
+    // Sent or dropped, the command no longer counts against its client
+    cmd_session_done(session_index);
+    return status;
+}
 
-            // Send the response to the stored address and port
-            if(udp_sendto(udp_pcb_handle, p, &g_server_addr, g_server_port) != ERR_OK)
-            {
-                pbuf_free(p);
-            	return -1;
-            }
-            // Free the pbuf
-            pbuf_free(p);
+/**
+ * @brief Moves the tests waiting in testsQ into the run order, as far as it has room.
+ * @details Executor only, it is the single reader of testsQ.
+ */
+static void executor_collect(void)
+{
+    queued_command_t *queued;
+
+    while (cmd_sched_ready() < CMD_SCHED_SLOTS && xQueueReceive(testsQHandle, &queued, 0) == pdPASS)
+    {
+        cmd_sched_put(&queued->sched);
+    }
+}
+
+/**
+ * @brief Sends the result and report to a client.
+ * @details The caller holds the tcpip core lock. The preallocated response pbuf
+ * is reused unless lwIP still holds it (ARP queue, MAC not done), in which case
+ * a pbuf is allocated for this result.
+ * @param result The result structure containing Test-ID and Pass/Fail status.
+ * @param report Optional report appended after the result (NULL or empty for none).
+ * @param addr The client's address.
+ * @param port The client's port.
+ * @return int 0 on success, -1 on failure.
+ */
+static int udp_send_result(result_pro_t result, const test_report_t *report, const ip_addr_t *addr, u16_t port)
+{
+    uint16_t report_length = (report != NULL) ? report->length : 0;
+    uint16_t length = sizeof(result_pro_t) + report_length;
+    uint32_t start = DWT->CYCCNT;
+    uint32_t cycles;
+    uint8_t reused;
+    struct pbuf *p;
+    err_t err;
+
+    // Check if we have a valid sender address
+    if (ip_addr_isany(addr) != 0 || length > RESPONSE_MAX_LENGTH)
+    {
+        response_errors++;
+        return -1;
+    }
+
+    reused = (response_pbuf != NULL) && (response_pbuf->ref == 1);
+    if (reused)
+    {
+        // Drop the headers prepended by the previous send
+        p = response_pbuf;
+        p->payload = response_payload;
+        p->len = length;
+        p->tot_len = length;
+    }
+    else
+    {
+        p = pbuf_alloc(PBUF_TRANSPORT, length, PBUF_RAM);
+        if (p == NULL)
+        {
+            response_errors++;
+            return -1;
         }
-        else{
-        	return -1;
+    }
+
+    // Copy the result struct, then the report, into the pbuf payload
+    memcpy(p->payload, &result, sizeof(result_pro_t));
+    if (report_length > 0)
+    {
+        memcpy((uint8_t *)p->payload + sizeof(result_pro_t), report->data, report_length);
+    }
+
+    // Send the response back to the client
+    err = udp_sendto(udp_pcb_handle, p, addr, port);
+    if (!reused)
+    {
+        pbuf_free(p);
+    }
+
+    cycles = DWT->CYCCNT - start;
+    if (err != ERR_OK)
+    {
+        response_errors++;
+        return -1;
+    }
+    responses_sent++;
+    if (reused)
+    {
+        response_cycles_total += cycles;
+        if (cycles > response_cycles_max)
+        {
+            response_cycles_max = cycles;
         }
     }
-    else{
-    	return -1;
+    else
+    {
+        response_allocs++;
+        response_alloc_cycles_total += cycles;
     }
+    return 0;
 }
 
 /**
- * @brief Hardware-accelerated CRC-32 calculation.
- * @param data Pointer to the buffer.
- * @param length Length of data in bytes.
- * @return uint32_t Computed CRC value.
+ * @brief Collects the response path and Ethernet receive/transmit counters.
+ * @param stats Filled with the counters since boot.
  */
-uint32_t calculate_crc(uint8_t *data, size_t length) {
-    // HAL_CRC_Calculate expects 32-bit words, so convert length
-    uint32_t word_count = (length + 3) / 4; // Round up
-    return HAL_CRC_Calculate(&hcrc, (uint32_t *)data, word_count);
+static void net_get_stats(net_stats_t *stats)
+{
+    uint32_t reused = responses_sent - response_allocs;
+
+    stats->responses = responses_sent;
+    stats->response_errors = response_errors;
+    stats->response_allocs = response_allocs;
+    stats->response_cycles_avg = reused ? (uint32_t)(response_cycles_total / reused) : 0;
+    stats->response_cycles_max = response_cycles_max;
+    stats->response_alloc_cycles_avg = response_allocs ? (uint32_t)(response_alloc_cycles_total / response_allocs) : 0;
+
+    stats->rx_irqs = ethernetif_rx_stats.irqs;
+    stats->rx_frames = ethernetif_rx_stats.frames;
+    stats->rx_batches = ethernetif_rx_stats.batches;
+    stats->rx_input_drops = ethernetif_rx_stats.input_drops;
+    stats->rx_alloc_drops = ethernetif_rx_stats.alloc_drops;
+    stats->rx_mac_drops = ethernetif_rx_stats.mac_drops;
+    stats->rx_cycles_per_frame = ethernetif_rx_stats.frames ? (uint32_t)(ethernetif_rx_stats.cycles / ethernetif_rx_stats.frames) : 0;
+
+    stats->tx_frames = ethernetif_tx_stats.frames;
+    stats->tx_queued = ethernetif_tx_stats.queued;
+    stats->tx_drops = ethernetif_tx_stats.drops;
+    stats->tx_reclaims = ethernetif_tx_stats.reclaims;
+    stats->tx_queue_max = ethernetif_tx_stats.queue_max;
+    stats->uptime_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    stats->tcp_connections = tcp_channel_stats.connections;
+    stats->tcp_commands = tcp_channel_stats.commands;
+    stats->tcp_results = tcp_channel_stats.results;
+    stats->tcp_stalls = tcp_channel_stats.stalls;
+    stats->tcp_result_drops = tcp_channel_stats.result_drops;
+    stats->mqtt_connects = mqtt_telemetry_stats.connects;
+    stats->mqtt_published = mqtt_telemetry_stats.published;
+    stats->mqtt_publish_errors = mqtt_telemetry_stats.publish_errors;
+    stats->mqtt_result_drops = mqtt_telemetry_stats.result_drops;
 }
 
-/* USER CODE END 4 */
+/**
+ * @brief Fills the lwIP memory profile sizes next to their high-water marks
+ * and allocation failures since boot.
+ */
+static void netmem_get_stats(netmem_stats_t *stats)
+{
+    stats->profile = LWIP_MEM_PROFILE;
+    stats->rx_pool_size = memp_RX_POOL.num;
+    stats->rx_pool_max = memp_RX_POOL.stats->max;
+    stats->rx_pool_errors = memp_RX_POOL.stats->err;
+    stats->pbuf_ref_size = MEMP_NUM_PBUF;
+    stats->pbuf_ref_max = lwip_stats.memp[MEMP_PBUF]->max;
+    stats->pbuf_ref_errors = lwip_stats.memp[MEMP_PBUF]->err;
+    stats->pbuf_pool_size = PBUF_POOL_SIZE;
+    stats->pbuf_pool_max = lwip_stats.memp[MEMP_PBUF_POOL]->max;
+    stats->pbuf_pool_errors = lwip_stats.memp[MEMP_PBUF_POOL]->err;
+    stats->inpkt_size = MEMP_NUM_TCPIP_MSG_INPKT;
+    stats->inpkt_max = lwip_stats.memp[MEMP_TCPIP_MSG_INPKT]->max;
+    stats->inpkt_errors = lwip_stats.memp[MEMP_TCPIP_MSG_INPKT]->err;
+    stats->heap_size = MEM_SIZE;
+    stats->heap_max = lwip_stats.mem.max;
+    stats->heap_errors = lwip_stats.mem.err;
+    stats->tcpip_mbox_size = TCPIP_MBOX_SIZE;
+    stats->tx_queue_size = ETH_TX_QUEUE_LEN;
+    stats->tx_queue_max = ethernetif_tx_stats.queue_max;
+}
 
-/* USER CODE BEGIN Header_lwip_initiation */
 /**
-  * @brief  Function implementing the defaultTask thread.
-  * @param  argument: Not used
-  * @retval None
-  */
-/* USER CODE END Header_lwip_initiation */
-void lwip_initiation(void *argument)
+ * @brief Takes the NET_METRICS snapshot. Every counter has a single writer,
+ * so they are read without taking the core lock; a sample may straddle an
+ * update by one event.
+ */
+static void net_get_metrics(net_metrics_t *metrics)
 {
-  /* init code for LWIP */
-  MX_LWIP_Init();
-  /* USER CODE BEGIN 5 */
-  /* Infinite loop */
-  for(;;)
-  {
-    osDelay(1);
-  }
-  /* USER CODE END 5 */
+    metrics->uptime_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    metrics->link_up = netif_is_link_up(&gnetif) ? 1 : 0;
+    metrics->link_recv = lwip_stats.link.recv;
+    metrics->link_xmit = lwip_stats.link.xmit;
+    metrics->link_drop = lwip_stats.link.drop;
+    metrics->link_err = lwip_stats.link.lenerr + lwip_stats.link.memerr;
+
+    metrics->eth_rx_irqs = ethernetif_rx_stats.irqs;
+    metrics->eth_rx_mac_drops = ethernetif_rx_stats.mac_drops;
+    metrics->eth_rx_alloc_drops = ethernetif_rx_stats.alloc_drops;
+    metrics->eth_tx_queued = ethernetif_tx_stats.queued;
+    metrics->eth_tx_drops = ethernetif_tx_stats.drops;
+
+    metrics->rx_pool_used = memp_RX_POOL.stats->used;
+    metrics->pbuf_ref_used = lwip_stats.memp[MEMP_PBUF]->used;
+    metrics->pbuf_ref_errors = lwip_stats.memp[MEMP_PBUF]->err;
+    metrics->pbuf_pool_used = lwip_stats.memp[MEMP_PBUF_POOL]->used;
+    metrics->pbuf_pool_errors = lwip_stats.memp[MEMP_PBUF_POOL]->err;
+    metrics->mem_used = lwip_stats.mem.used;
+    metrics->mem_errors = lwip_stats.mem.err;
+
+    metrics->udp_recv = lwip_stats.udp.recv;
+    metrics->udp_xmit = lwip_stats.udp.xmit;
+    metrics->udp_drop = lwip_stats.udp.drop;
+    metrics->udp_errors = lwip_stats.udp.rterr + lwip_stats.udp.memerr;
+
+    metrics->cmdq_enqueued = cmdq_enqueued;
+    metrics->cmdq_full = cmdq_full;
+    metrics->cmdq_rejected = cmdq_rejected;
+    metrics->cmdq_depth = uxQueueMessagesWaiting(testsQHandle) + cmd_sched_ready();
+    metrics->cmdq_depth_max = cmdq_depth_max;
+    metrics->cmdq_quota = cmdq_quota;
+    metrics->sessions_active = cmd_session_active();
+    metrics->cache_replays = result_cache_stats.replays;
+    metrics->cache_coalesced = result_cache_stats.coalesced;
 }
 
-/* USER CODE BEGIN Header_blinking_blue */
 /**
-* @brief Function implementing the blink_task thread.
-* @param argument: Not used
-* @retval None
-*/
-/* USER CODE END Header_blinking_blue */
-void blinking_blue(void *argument)
+ * @brief Records the time from reset to the command socket being bound,
+ * and the heap state at that point.
+ * @details The cycle counter stops while tickless idle sleeps, so it only
+ * times the stages up to the scheduler start; the RTOS tick, which is
+ * stepped over each sleep, times the rest.
+ */
+static void boot_mark_ready(void)
 {
-  /* USER CODE BEGIN blinking_blue */
-  /* Infinite loop */
-  for(;;)
-  {
-	/* visual heartbeat */
-	HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_7);
-    osDelay(1000);
-  }
-  /* USER CODE END blinking_blue */
+    uint32_t cycles = DWT->CYCCNT;
+    heap_stats_t heap;
+
+    heap_get_stats(&heap);
+    boot_stats.ready_cycles = cycles;
+    boot_stats.kernel_start_us = boot_hsi_cycles / (HSI_VALUE / 1000000U)
+                               + (boot_kernel_cycles - boot_hsi_cycles) / (SystemCoreClock / 1000000U);
+    boot_stats.ready_us = boot_stats.kernel_start_us + xTaskGetTickCount() * portTICK_PERIOD_MS * 1000U;
+    boot_stats.heap_allocations = heap.allocations;
+    boot_stats.heap_free_bytes = heap.free_bytes;
+}
+
+/**
+ * @brief Collects the scheduler counters kept by the RTOS hooks in freertos.c.
+ * @param stats Filled with the counters since boot.
+ */
+static void sched_get_stats(sched_stats_t *stats)
+{
+    stats->uptime_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    stats->context_switches = sched_context_switches;
+    stats->sleeps = sched_sleeps;
+    stats->executor_wake_cycles_last = executor_wake_cycles_last;
+    stats->executor_wake_cycles_max = executor_wake_cycles_max;
+    stats->probe_wait_us_last = probe_wait_us_last;
+    stats->probe_wait_us_max = probe_wait_us_max;
+    stats->deadline_rejects = cmd_sched_stats.late_on_arrival + cmd_sched_stats.late_on_start;
+    stats->aged = cmd_sched_stats.aged;
 }
 
-/* USER CODE BEGIN Header_udp_function */
 int __io_putchar(int ch)
 {
     HAL_UART_Transmit(&huart3, (uint8_t*)&ch, 1, HAL_MAX_DELAY);
     return ch;
 }
+
 /**
-* @brief Function implementing the udp_task thread.
-* @param argument: Not used
-* @retval None
-*/
-/* USER CODE END Header_udp_function */
-void udp_function(void *argument)
+ * @brief Function implementing the probe_task thread.
+ * @details Answers aborts and SYSTEM_P queries from probeQ. It runs above the
+ * executor and queries touch no peripheral, so they are answered while a test
+ * runs instead of queueing behind it.
+ * @param argument: Not used
+ */
+void answer_probes(void *argument)
 {
-  /* USER CODE BEGIN udp_function */
-	udp_receive_init();
-  /* Infinite loop */
-  for(;;)
-  {
-    osDelay(1);
-  }
-  /* USER CODE END udp_function */
+    queued_command_t *queued;
+    static test_report_t report;
+    result_pro_t response;
+    uint8_t session;
+    uint32_t tag;
+    uint32_t wait_us;
+
+    for (;;)
+    {
+        if (xQueueReceive(probeQHandle, &queued, portMAX_DELAY) != pdPASS)
+        {
+            continue;
+        }
+        wait_us = (DWT->CYCCNT - queued->submitted_cycles) / (SystemCoreClock / 1000000U);
+        probe_wait_us_last = wait_us;
+        if (wait_us > probe_wait_us_max)
+        {
+            probe_wait_us_max = wait_us;
+        }
+
+        // Control commands were acted on when they arrived, only the answer is left.
+        // An abort that stopped the running test answers after its TEST_ABORTED
+        if (queued->cmd.peripheral == CMD_ABORT)
+        {
+            if (queued->control_result != TEST_PASS || !test_abort_hold(queued))
+            {
+                answer_control(queued);
+            }
+            continue;
+        }
+
+        response.test_id = queued->cmd.test_id;
+        report.length = 0;
+        if (queued->cmd.test_id == 0 || queued->cmd.iterations < 1)
+        {
+            response.test_result = TEST_ERR;
+        }
+        else
+        {
+            response.test_result = run_query(&queued->cmd, &report);
+        }
+        session = queued->session;
+        tag = queued->tag;
+        vPortFree(queued);
+
+#if LWIP_IGMP
+        // Fleet queries keep their spread, the next query does not wait for it
+        if (cmd_sessions[session].origin == CMD_ORIGIN_UDP && tag != 0)
+        {
+            command_reply_later(session, tag, response, &report);
+            continue;
+        }
+#endif
+        command_reply(session, tag, 0, response, &report);
+    }
 }
 
+/**
+ * @brief Sends a control command's answer, decided on arrival, and frees it.
+ */
+static void answer_control(queued_command_t *queued)
+{
+    result_pro_t response = {queued->cmd.test_id, queued->control_result};
+    uint8_t session = queued->session;
+    uint32_t tag = queued->tag;
+
+    vPortFree(queued);
+#if LWIP_IGMP
+    if (cmd_sessions[session].origin == CMD_ORIGIN_UDP && tag != 0)
+    {
+        command_reply_later(session, tag, response, NULL);
+        return;
+    }
+#endif
+    command_reply(session, tag, 0, response, NULL);
+}
+
+/**
+ * @brief Sends the answers of the aborts that stopped the test just reported.
+ * @details Executor only, after the test's result.
+ */
+static void answer_held_aborts(void)
+{
+    queued_command_t *queued;
+
+    while ((queued = (queued_command_t *)test_abort_reported()) != NULL)
+    {
+        answer_control(queued);
+    }
+}
+
+/**
+ * @brief Answers a SYSTEM_P query into the report.
+ * @return TEST_PASS, or TEST_ERR for an unknown query.
+ */
+static Result run_query(const test_command_t *cmd, test_report_t *report)
+{
+    switch (cmd->peripheral)
+    {
+    case HEAP_STATS:
+        heap_get_stats((heap_stats_t *)report->data);
+        report->length = sizeof(heap_stats_t);
+        break;
+    case BOOT_STATS:
+        memcpy(report->data, &boot_stats, sizeof(boot_stats_t));
+        report->length = sizeof(boot_stats_t);
+        break;
+    case SCHED_STATS:
+        sched_get_stats((sched_stats_t *)report->data);
+        report->length = sizeof(sched_stats_t);
+        break;
+    case NET_STATS:
+        net_get_stats((net_stats_t *)report->data);
+        report->length = sizeof(net_stats_t);
+        break;
+    case NETMEM_STATS:
+        netmem_get_stats((netmem_stats_t *)report->data);
+        report->length = sizeof(netmem_stats_t);
+        break;
+    case NET_METRICS:
+        net_get_metrics((net_metrics_t *)report->data);
+        report->length = sizeof(net_metrics_t);
+        break;
+    case IPERF_STATS:
+        memcpy(report->data, &iperf_stats, sizeof(iperf_stats_t));
+        report->length = sizeof(iperf_stats_t);
+        break;
+    default:
+        return TEST_ERR;
+    }
+    return TEST_PASS;
+}
+
+/* USER CODE END 4 */
+
 /* USER CODE BEGIN Header_perform_tests */
 /**
 * @brief Function implementing the performing_task thread:
-* sorting the commands to its test (UART/SPI/etc.)
+* brings up lwIP and the command socket once, then sorts
+* the commands to its test (UART/SPI/etc.)
 * @param argument: Not used (using queue instead)
 * @retval None
 */
 /* USER CODE END Header_perform_tests */
 void perform_tests(void *argument)
 {
+  /* init code for LWIP */
+  MX_LWIP_Init();
   /* USER CODE BEGIN perform_tests */
+	queued_command_t *queued;
+	cmd_sched_entry_t *entry;
 	test_command_t *cmd;
+	static test_report_t report;
+	uint8_t aborted;
+
+	// One-shot start-up, the executor then blocks until a command arrives
+	LOCK_TCPIP_CORE();
+	udp_receive_init();
+	tcp_channel_init();
+#if MQTT_TELEMETRY
+	mqtt_telemetry_init(net_get_metrics);
+#endif
+#if IPERF_SERVER
+	iperf_server_init();
+#endif
+	UNLOCK_TCPIP_CORE();
+	boot_mark_ready();
 
   /* Infinite loop */
   for(;;)
   {
-	ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // waiting for a notification
+	// The executor outranks the tcpip thread, so a submit that sees the flag
+	// set finds it blocked; a pending notification returns before any submit
+	executor_waiting = 1;
+	ulTaskNotifyTake(pdFALSE, portMAX_DELAY); // waiting for a notification, one per queued command
+	executor_waiting = 0;
 
-	if (xQueueReceive(testsQHandle, &cmd, 0) != pdPASS)
+	if (executor_notified)
+	{
+		executor_notified = 0;
+		executor_wake_cycles_last = DWT->CYCCNT - executor_notify_cycles;
+		if (executor_wake_cycles_last > executor_wake_cycles_max)
+		{
+			executor_wake_cycles_max = executor_wake_cycles_last;
+		}
+	}
+
+	// The most urgent test runs next, not the oldest
+	executor_collect();
+	entry = cmd_sched_take();
+	if (entry == NULL)
 	{
 		continue;
 	}
+	queued = (queued_command_t *)entry->owner;
+	cmd = &queued->cmd;
+	executing_session = queued->session;
+	executing_tag = queued->tag;
 	result_pro_t response;
 
+	response.test_id = cmd->test_id;
+	// Aborted while it waited in testsQ: answered without running
+	if (test_abort_cancelled(queued->session, cmd->test_id))
+	{
+		test_abort_report_t *partial = (test_abort_report_t *)report.data;
+
+		partial->iterations_done = 0;
+		partial->iterations_requested = cmd->iterations;
+		partial->elapsed_ms = 0;
+		report.length = sizeof(test_abort_report_t);
+		response.test_result = TEST_ABORTED;
+		vPortFree(queued);
+		send_report(response, &report);
+		continue;
+	}
+	// Exactly one result per command, the TCP window accounting relies on it
 	if(cmd->bit_pattern_length > MAX_BIT_PATTERN_LENGTH || cmd->test_id == NULL || cmd->iterations < 1){
 		response.test_result =TEST_ERR;
+		vPortFree(queued);
 		send_response(response);
+		continue;
 	}
-	response.test_id = cmd->test_id;
+	// Waiting used up its deadline, answered without running
+	if (cmd_sched_late(entry))
+	{
+		response.test_result = TEST_DEADLINE;
+		vPortFree(queued);
+		send_response(response);
+		continue;
+	}
+	report.length = 0;
+	sched_stay_awake = 1;
+	test_abort_begin(queued->session, cmd);
+	cmd_sched_begin(entry);
 
 	switch (cmd->peripheral){
 	case TIMER:
-		response.test_result = timer_testing(cmd);
+	case TIMER_LIMITS:
+		response.test_result = timer_testing(cmd, &report);
+		break;
+	case TIMER_STRESS:
+		response.test_result = timer_stress_testing(cmd, &report);
+		break;
+	case TIMER_PWM:
+		response.test_result = timer_pwm_testing(cmd, &report);
 		break;
 	case UART:
 		response.test_result = uart_testing(cmd);
@@ -1211,17 +2007,67 @@ void perform_tests(void *argument)
 	case ADC_P:
 		response.test_result = adc_testing(cmd);
 		break;
+	case ADC_SWEEP:
+		response.test_result = adc_sweep_testing(cmd);
+		break;
+	case ADC_LINEARITY:
+		response.test_result = adc_linearity_testing(cmd, &report);
+		break;
+	case ADC_SCAN:
+		response.test_result = adc_scan_testing(cmd, &report);
+		break;
 	default:
 		response.test_result = TEST_ERR;
         break;
 	}
-    vPortFree(cmd);
-    osDelay(1);
-    send_response(response);
+	sched_stay_awake = 0;
+	// Whatever the test returned on its way out, an abort is reported as such
+	aborted = test_abort_end(&report);
+	cmd_sched_end(entry, !aborted);
+	if (aborted)
+	{
+		response.test_result = TEST_ABORTED;
+	}
+    vPortFree(queued);
+#if LWIP_IGMP
+    if (cmd_sessions[executing_session].origin == CMD_ORIGIN_UDP && executing_tag != 0)
+    {
+        // A fleet command's tag is its reply delay, the next test starts meanwhile
+        command_reply_later(executing_session, executing_tag, response, &report);
+        answer_held_aborts();
+        continue;
+    }
+#endif
+    if (cmd_sessions[executing_session].origin == CMD_ORIGIN_UDP)
+    {
+        osDelay(1);
+    }
+    send_report(response, &report);
+    answer_held_aborts();
   }
   /* USER CODE END perform_tests */
 }
 
+/* USER CODE BEGIN Header_blinking_blue */
+/**
+* @brief Function implementing the blink_task thread.
+* @param argument: Not used
+* @retval None
+*/
+/* USER CODE END Header_blinking_blue */
+void blinking_blue(void *argument)
+{
+  /* USER CODE BEGIN blinking_blue */
+  /* Infinite loop */
+  for(;;)
+  {
+	/* visual heartbeat */
+	HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_7);
+    osDelay(1000);
+  }
+  /* USER CODE END blinking_blue */
+}
+
 /**
   * @brief  Period elapsed callback in non blocking mode
   * @note   This function handles both the System Tick (TIM6) and the Timer Hardware Test (TIM7).
@@ -1243,6 +2089,16 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
   /* USER CODE BEGIN Callback 1 */
   if (htim->Instance == TIM7)
   {
+	    // Timestamp the pulse for the period/latency measurement
+	    tim7_isr_cycles = DWT->CYCCNT;
+
+	    // Stress bursts are counted in the ISR and signalled once at the end
+	    if (timer_stress_target != 0)
+	    {
+	        timer_stress_pulse_from_isr();
+	        return;
+	    }
+
 	    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
 	    // Use the ISR-safe function to give the semaphore
@@ -77,6 +77,10 @@ extern UART_HandleTypeDef huart3;
 extern TIM_HandleTypeDef htim6;
 
 /* USER CODE BEGIN EV */
+extern DMA_HandleTypeDef hdma_adc1;
+extern DMA_HandleTypeDef hdma_tim1_ch1;
+extern DMA_HandleTypeDef hdma_crc;
+extern DMA_HandleTypeDef hdma_dac1;
 
 /* USER CODE END EV */
 
@@ -228,6 +232,12 @@ void DMA1_Stream2_IRQHandler(void)
 void DMA1_Stream5_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Stream5_IRQn 0 */
+  /* Stream shared with DAC1 while an ADC sweep test owns it */
+  if (hdma_dac1.State != HAL_DMA_STATE_RESET)
+  {
+    HAL_DMA_IRQHandler(&hdma_dac1);
+    return;
+  }
 
   /* USER CODE END DMA1_Stream5_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_i2c4_tx);
@@ -534,4 +544,28 @@ void I2C4_ER_IRQHandler(void)
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief This function handles DMA2 stream4 global interrupt (ADC1 sweep capture).
+  */
+void DMA2_Stream4_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_adc1);
+}
+
+/**
+  * @brief This function handles DMA2 stream6 global interrupt (TIM1 PWM capture).
+  */
+void DMA2_Stream6_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_tim1_ch1);
+}
+
+/**
+  * @brief This function handles DMA2 stream7 global interrupt (CRC feed).
+  */
+void DMA2_Stream7_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_crc);
+}
+
 /* USER CODE END 1 */
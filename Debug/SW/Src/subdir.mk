@@ -6,22 +6,52 @@
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
 ../SW/Src/adcs.c \
+../SW/Src/cmd_sched.c \
+../SW/Src/cmd_sessions.c \
+../SW/Src/crcs.c \
+../SW/Src/dma_arena.c \
+../SW/Src/heap_tlsf.c \
 ../SW/Src/i2cs.c \
+../SW/Src/iperf_server.c \
+../SW/Src/mqtt_telemetry.c \
+../SW/Src/result_cache.c \
 ../SW/Src/spis.c \
+../SW/Src/tcp_channel.c \
+../SW/Src/test_abort.c \
 ../SW/Src/timer_test.c \
 ../SW/Src/uarts.c 
 
 OBJS += \
 ./SW/Src/adcs.o \
+./SW/Src/cmd_sched.o \
+./SW/Src/cmd_sessions.o \
+./SW/Src/crcs.o \
+./SW/Src/dma_arena.o \
+./SW/Src/heap_tlsf.o \
 ./SW/Src/i2cs.o \
+./SW/Src/iperf_server.o \
+./SW/Src/mqtt_telemetry.o \
+./SW/Src/result_cache.o \
 ./SW/Src/spis.o \
+./SW/Src/tcp_channel.o \
+./SW/Src/test_abort.o \
 ./SW/Src/timer_test.o \
 ./SW/Src/uarts.o 
 
 C_DEPS += \
 ./SW/Src/adcs.d \
+./SW/Src/cmd_sched.d \
+./SW/Src/cmd_sessions.d \
+./SW/Src/crcs.d \
+./SW/Src/dma_arena.d \
+./SW/Src/heap_tlsf.d \
 ./SW/Src/i2cs.d \
+./SW/Src/iperf_server.d \
+./SW/Src/mqtt_telemetry.d \
+./SW/Src/result_cache.d \
 ./SW/Src/spis.d \
+./SW/Src/tcp_channel.d \
+./SW/Src/test_abort.d \
 ./SW/Src/timer_test.d \
 ./SW/Src/uarts.d 
 
@@ -33,7 +63,7 @@ SW/Src/%.o SW/Src/%.su SW/Src/%.cyclo: ../SW/Src/%.c SW/Src/subdir.mk
 clean: clean-SW-2f-Src
 
 clean-SW-2f-Src:
-	-$(RM) ./SW/Src/adcs.cyclo ./SW/Src/adcs.d ./SW/Src/adcs.o ./SW/Src/adcs.su ./SW/Src/i2cs.cyclo ./SW/Src/i2cs.d ./SW/Src/i2cs.o ./SW/Src/i2cs.su ./SW/Src/spis.cyclo ./SW/Src/spis.d ./SW/Src/spis.o ./SW/Src/spis.su ./SW/Src/timer_test.cyclo ./SW/Src/timer_test.d ./SW/Src/timer_test.o ./SW/Src/timer_test.su ./SW/Src/uarts.cyclo ./SW/Src/uarts.d ./SW/Src/uarts.o ./SW/Src/uarts.su
+	-$(RM) ./SW/Src/adcs.cyclo ./SW/Src/adcs.d ./SW/Src/adcs.o ./SW/Src/adcs.su ./SW/Src/cmd_sched.cyclo ./SW/Src/cmd_sched.d ./SW/Src/cmd_sched.o ./SW/Src/cmd_sched.su ./SW/Src/cmd_sessions.cyclo ./SW/Src/cmd_sessions.d ./SW/Src/cmd_sessions.o ./SW/Src/cmd_sessions.su ./SW/Src/crcs.cyclo ./SW/Src/crcs.d ./SW/Src/crcs.o ./SW/Src/crcs.su ./SW/Src/dma_arena.cyclo ./SW/Src/dma_arena.d ./SW/Src/dma_arena.o ./SW/Src/dma_arena.su ./SW/Src/heap_tlsf.cyclo ./SW/Src/heap_tlsf.d ./SW/Src/heap_tlsf.o ./SW/Src/heap_tlsf.su ./SW/Src/i2cs.cyclo ./SW/Src/i2cs.d ./SW/Src/i2cs.o ./SW/Src/i2cs.su ./SW/Src/iperf_server.cyclo ./SW/Src/iperf_server.d ./SW/Src/iperf_server.o ./SW/Src/iperf_server.su ./SW/Src/mqtt_telemetry.cyclo ./SW/Src/mqtt_telemetry.d ./SW/Src/mqtt_telemetry.o ./SW/Src/mqtt_telemetry.su ./SW/Src/result_cache.cyclo ./SW/Src/result_cache.d ./SW/Src/result_cache.o ./SW/Src/result_cache.su ./SW/Src/spis.cyclo ./SW/Src/spis.d ./SW/Src/spis.o ./SW/Src/spis.su ./SW/Src/tcp_channel.cyclo ./SW/Src/tcp_channel.d ./SW/Src/tcp_channel.o ./SW/Src/tcp_channel.su ./SW/Src/test_abort.cyclo ./SW/Src/test_abort.d ./SW/Src/test_abort.o ./SW/Src/test_abort.su ./SW/Src/timer_test.cyclo ./SW/Src/timer_test.d ./SW/Src/timer_test.o ./SW/Src/timer_test.su ./SW/Src/uarts.cyclo ./SW/Src/uarts.d ./SW/Src/uarts.o ./SW/Src/uarts.su
 
 .PHONY: clean-SW-2f-Src
 
@@ -51,6 +51,9 @@ uint8_t GATEWAY_ADDRESS[4];
 /* USER CODE BEGIN OS_THREAD_ATTR_CMSIS_RTOS_V2 */
 #define INTERFACE_THREAD_STACK_SIZE ( 1024 )
 osThreadAttr_t attributes;
+/* Link thread created from static storage */
+static uint32_t EthLinkTaskBuffer[INTERFACE_THREAD_STACK_SIZE / sizeof(uint32_t)];
+static StaticTask_t EthLinkControlBlock;
 /* USER CODE END OS_THREAD_ATTR_CMSIS_RTOS_V2 */
 
 /* USER CODE BEGIN 2 */
@@ -103,7 +106,10 @@ void MX_LWIP_Init(void)
 /* USER CODE BEGIN H7_OS_THREAD_NEW_CMSIS_RTOS_V2 */
   memset(&attributes, 0x0, sizeof(osThreadAttr_t));
   attributes.name = "EthLink";
-  attributes.stack_size = INTERFACE_THREAD_STACK_SIZE;
+  attributes.cb_mem = &EthLinkControlBlock;
+  attributes.cb_size = sizeof(EthLinkControlBlock);
+  attributes.stack_mem = &EthLinkTaskBuffer[0];
+  attributes.stack_size = sizeof(EthLinkTaskBuffer);
   attributes.priority = osPriorityBelowNormal;
   osThreadNew(ethernet_link_thread, &gnetif, &attributes);
 /* USER CODE END H7_OS_THREAD_NEW_CMSIS_RTOS_V2 */
@@ -54,7 +54,13 @@
 #define ETH_TX_BUFFER_MAX             ((ETH_TX_DESC_CNT) * 2U)
 
 /* USER CODE BEGIN 1 */
-
+/* RX interrupt coalescing: the DMA raises an interrupt every ETH_RX_COALESCE_FRAMES
+   frames, or ETH_RX_COALESCE_US after the last frame when fewer arrive */
+#define ETH_RX_COALESCE_FRAMES        4U
+#define ETH_RX_COALESCE_US            100U
+#define ETH_RX_WATCHDOG_UNIT          256U    /* HCLK cycles per DMARSWTR count */
+/* Frames handed to lwIP per core lock */
+#define ETH_RX_BATCH_MAX              ETH_RX_DESC_CNT
 /* USER CODE END 1 */
 
 /* Private variables ---------------------------------------------------------*/
@@ -94,7 +100,9 @@ typedef struct
 } RxBuff_t;
 
 /* Memory Pool Declaration */
+#ifndef ETH_RX_BUFFER_CNT   /* Sized by LWIP_MEM_PROFILE in lwipopts.h */
 #define ETH_RX_BUFFER_CNT             24U
+#endif
 LWIP_MEMPOOL_DECLARE(RX_POOL, ETH_RX_BUFFER_CNT, sizeof(RxBuff_t), "Zero-copy RX PBUF pool");
 
 /* Variable Definitions */
@@ -104,13 +112,13 @@ static uint8_t RxAllocStatus;
 
 #pragma location=0x2004c000
 ETH_DMADescTypeDef  DMARxDscrTab[ETH_RX_DESC_CNT]; /* Ethernet Rx DMA Descriptors */
-#pragma location=0x2004c0a0
+#pragma location=0x2004c140
 ETH_DMADescTypeDef  DMATxDscrTab[ETH_TX_DESC_CNT]; /* Ethernet Tx DMA Descriptors */
 
 #elif defined ( __CC_ARM )  /* MDK ARM Compiler */
 
 __attribute__((at(0x2004c000))) ETH_DMADescTypeDef  DMARxDscrTab[ETH_RX_DESC_CNT]; /* Ethernet Rx DMA Descriptors */
-__attribute__((at(0x2004c0a0))) ETH_DMADescTypeDef  DMATxDscrTab[ETH_TX_DESC_CNT]; /* Ethernet Tx DMA Descriptors */
+__attribute__((at(0x2004c140))) ETH_DMADescTypeDef  DMATxDscrTab[ETH_TX_DESC_CNT]; /* Ethernet Tx DMA Descriptors */
 
 #elif defined ( __GNUC__ ) /* GNU Compiler */
 
@@ -120,7 +128,33 @@ ETH_DMADescTypeDef DMATxDscrTab[ETH_TX_DESC_CNT] __attribute__((section(".TxDecr
 #endif
 
 /* USER CODE BEGIN 2 */
-
+ethernetif_rx_stats_t ethernetif_rx_stats;
+ethernetif_tx_stats_t ethernetif_tx_stats;
+static uint32_t RxDescBuilt;      /* Descriptors refilled, paces the RX interrupts */
+static uint32_t RxMemerrCounted;  /* alloc_drops already added to link.memerr */
+
+/* TX queue, only touched with the tcpip core lock held */
+static struct pbuf *TxQueue[ETH_TX_QUEUE_LEN];
+static uint32_t TxQueueHead;
+static uint32_t TxQueueCount;
+static ETH_BufferTypeDef Txbuffer[ETH_TX_DESC_CNT];
+static volatile uint8_t TxReclaimPending;   /* Set by the TX complete IRQ */
+
+/* Interface thread and packet semaphores are created from static storage */
+static uint32_t EthIfTaskBuffer[INTERFACE_THREAD_STACK_SIZE / sizeof(uint32_t)];
+static StaticTask_t EthIfControlBlock;
+static StaticSemaphore_t RxPktControlBlock;
+static StaticSemaphore_t TxPktControlBlock;
+static const osSemaphoreAttr_t RxPkt_attributes = {
+  .name = "RxPkt",
+  .cb_mem = &RxPktControlBlock,
+  .cb_size = sizeof(RxPktControlBlock),
+};
+static const osSemaphoreAttr_t TxPkt_attributes = {
+  .name = "TxPkt",
+  .cb_mem = &TxPktControlBlock,
+  .cb_size = sizeof(TxPktControlBlock),
+};
 /* USER CODE END 2 */
 
 osSemaphoreId RxPktSemaphore = NULL;   /* Semaphore to signal incoming packets */
@@ -145,7 +179,9 @@ lan8742_IOCtx_t  LAN8742_IOCtx = {ETH_PHY_IO_Init,
                                   ETH_PHY_IO_GetTick};
 
 /* USER CODE BEGIN 3 */
-
+static HAL_StatusTypeDef low_level_transmit(struct pbuf *p);
+static void ethernetif_tx_drain(void);
+static void ethernetif_tx_reclaim(void);
 /* USER CODE END 3 */
 
 /* Private functions ---------------------------------------------------------*/
@@ -158,6 +194,7 @@ void pbuf_free_custom(struct pbuf *p);
   */
 void HAL_ETH_RxCpltCallback(ETH_HandleTypeDef *handlerEth)
 {
+  ethernetif_rx_stats.irqs++;
   osSemaphoreRelease(RxPktSemaphore);
 }
 /**
@@ -167,7 +204,9 @@ void HAL_ETH_RxCpltCallback(ETH_HandleTypeDef *handlerEth)
   */
 void HAL_ETH_TxCpltCallback(ETH_HandleTypeDef *handlerEth)
 {
-  osSemaphoreRelease(TxPktSemaphore);
+  /* Completed descriptors are reclaimed in one batch by the interface thread */
+  TxReclaimPending = 1U;
+  osSemaphoreRelease(RxPktSemaphore);
 }
 /**
   * @brief  Ethernet DMA transfer error callback
@@ -183,7 +222,77 @@ void HAL_ETH_ErrorCallback(ETH_HandleTypeDef *handlerEth)
 }
 
 /* USER CODE BEGIN 4 */
+#if LWIP_IGMP
+/* Multicast groups per MAC hash bit, the bit is cleared when the last one leaves */
+static uint8_t McastHashUsers[64];
+
+/**
+ * @brief Index of a MAC address in the 64 bit multicast hash table: the upper
+ *        6 bits of the bit-reversed, inverted Ethernet CRC of the address.
+ */
+static uint32_t ethernetif_mac_hash(const uint8_t *mac)
+{
+  uint32_t crc = 0xFFFFFFFFU;
+  uint32_t i, bit;
+
+  for (i = 0; i < ETH_HWADDR_LEN; i++)
+  {
+    crc ^= mac[i];
+    for (bit = 0; bit < 8U; bit++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+  }
+  return __RBIT(~crc) >> 26;
+}
+
+/**
+ * @brief Lets the frames of a joined IGMP group through the MAC filter.
+ *        Called by lwIP, in the tcpip thread or under its lock.
+ */
+static err_t ethernetif_igmp_mac_filter(struct netif *netif, const ip4_addr_t *group,
+                                        enum netif_mac_filter_action action)
+{
+  ETH_MACFilterConfigTypeDef filter;
+  uint32_t table[2] = {0, 0};
+  uint8_t mac[ETH_HWADDR_LEN];
+  uint32_t index, i;
+
+  /* 01:00:5e followed by the low 23 bits of the group address */
+  mac[0] = 0x01;
+  mac[1] = 0x00;
+  mac[2] = 0x5E;
+  mac[3] = ip4_addr2(group) & 0x7FU;
+  mac[4] = ip4_addr3(group);
+  mac[5] = ip4_addr4(group);
+  index = ethernetif_mac_hash(mac);
+
+  if (action == NETIF_ADD_MAC_FILTER)
+  {
+    McastHashUsers[index]++;
+  }
+  else if (McastHashUsers[index] > 0U)
+  {
+    McastHashUsers[index]--;
+  }
+
+  /* Bit 5 of the index picks the high register, table[0] is written to MACHTHR */
+  for (i = 0; i < 64U; i++)
+  {
+    if (McastHashUsers[i] > 0U)
+    {
+      table[(i >> 5) ^ 1U] |= 1UL << (i & 31U);
+    }
+  }
+  HAL_ETH_SetHashTable(&heth, table);
 
+  /* Unicast stays on the perfect filter, multicast goes through the hash */
+  HAL_ETH_GetMACFilterConfig(&heth, &filter);
+  filter.HashMulticast = ENABLE;
+  HAL_ETH_SetMACFilterConfig(&heth, &filter);
+  return ERR_OK;
+}
+#endif /* LWIP_IGMP */
 /* USER CODE END 4 */
 
 /*******************************************************************************
@@ -201,6 +310,7 @@ static void low_level_init(struct netif *netif)
   HAL_StatusTypeDef hal_eth_init_status = HAL_OK;
 /* USER CODE BEGIN OS_THREAD_ATTR_CMSIS_RTOS_V2 */
   osThreadAttr_t attributes;
+  uint32_t rswtc;
 /* USER CODE END OS_THREAD_ATTR_CMSIS_RTOS_V2 */
   uint32_t duplex, speed = 0;
   int32_t PHYLinkState = 0;
@@ -262,22 +372,32 @@ static void low_level_init(struct netif *netif)
   #endif /* LWIP_ARP */
 
   /* create a binary semaphore used for informing ethernetif of frame reception */
-  RxPktSemaphore = osSemaphoreNew(1, 0, NULL);
+  RxPktSemaphore = osSemaphoreNew(1, 0, &RxPkt_attributes);
 
   /* create a binary semaphore used for informing ethernetif of frame transmission */
-  TxPktSemaphore = osSemaphoreNew(1, 0, NULL);
+  TxPktSemaphore = osSemaphoreNew(1, 0, &TxPkt_attributes);
 
   /* create the task that handles the ETH_MAC */
 /* USER CODE BEGIN OS_THREAD_NEW_CMSIS_RTOS_V2 */
   memset(&attributes, 0x0, sizeof(osThreadAttr_t));
   attributes.name = "EthIf";
-  attributes.stack_size = INTERFACE_THREAD_STACK_SIZE;
+  attributes.cb_mem = &EthIfControlBlock;
+  attributes.cb_size = sizeof(EthIfControlBlock);
+  attributes.stack_mem = &EthIfTaskBuffer[0];
+  attributes.stack_size = sizeof(EthIfTaskBuffer);
   attributes.priority = osPriorityRealtime;
   osThreadNew(ethernetif_input, netif, &attributes);
 /* USER CODE END OS_THREAD_NEW_CMSIS_RTOS_V2 */
 
 /* USER CODE BEGIN PHY_PRE_CONFIG */
-
+#if LWIP_IGMP
+  /* Set before netif_add() returns so it starts IGMP, even with the link down */
+  netif->flags |= NETIF_FLAG_IGMP;
+  netif_set_igmp_mac_filter(netif, ethernetif_igmp_mac_filter);
+#endif
+  /* Receive watchdog: closes the coalescing window for descriptors without an interrupt */
+  rswtc = (ETH_RX_COALESCE_US * (HAL_RCC_GetHCLKFreq() / 1000000U)) / ETH_RX_WATCHDOG_UNIT;
+  heth.Instance->DMARSWTR = (rswtc == 0U) ? 1U : ((rswtc > 0xFFU) ? 0xFFU : rswtc);
 /* USER CODE END PHY_PRE_CONFIG */
   /* Set PHY IO functions */
   LAN8742_RegisterBusIO(&LAN8742, &LAN8742_IOCtx);
@@ -371,18 +491,67 @@ static void low_level_init(struct netif *netif)
  */
 
 static err_t low_level_output(struct netif *netif, struct pbuf *p)
+{
+  /* Frames already waiting go first, the new one queues behind them. Try to
+     move them on here too, a lost TX complete interrupt must not wedge them */
+  if (TxQueueCount > 0U)
+  {
+    ethernetif_tx_drain();
+  }
+  if (TxQueueCount == 0U)
+  {
+    switch (low_level_transmit(p))
+    {
+    case HAL_OK:
+      return ERR_OK;
+    case HAL_BUSY:
+      break;
+    default:
+      return ERR_IF;
+    }
+  }
+
+  /* No free descriptors: queue the frame rather than block the tcpip thread */
+  if (TxQueueCount == ETH_TX_QUEUE_LEN)
+  {
+    ethernetif_tx_stats.drops++;
+    LINK_STATS_INC(link.drop);
+    return ERR_MEM;
+  }
+  pbuf_ref(p);
+  TxQueue[(TxQueueHead + TxQueueCount) % ETH_TX_QUEUE_LEN] = p;
+  TxQueueCount++;
+  ethernetif_tx_stats.queued++;
+  if (TxQueueCount > ethernetif_tx_stats.queue_max)
+  {
+    ethernetif_tx_stats.queue_max = TxQueueCount;
+  }
+
+  return ERR_OK;
+}
+
+/**
+ * @brief Hands one frame to the DMA. The caller holds the tcpip core lock.
+ *
+ * @param p the frame, referenced until the descriptors are released
+ * @return HAL_OK when queued to the DMA, HAL_BUSY when no descriptors are
+ *         free, HAL_ERROR when the frame was dropped
+ */
+static HAL_StatusTypeDef low_level_transmit(struct pbuf *p)
 {
   uint32_t i = 0U;
   struct pbuf *q = NULL;
-  err_t errval = ERR_OK;
-  ETH_BufferTypeDef Txbuffer[ETH_TX_DESC_CNT] = {0};
 
   memset(Txbuffer, 0 , ETH_TX_DESC_CNT*sizeof(ETH_BufferTypeDef));
 
   for(q = p; q != NULL; q = q->next)
   {
     if(i >= ETH_TX_DESC_CNT)
-      return ERR_IF;
+    {
+      ethernetif_tx_stats.drops++;
+      LINK_STATS_INC(link.drop);
+      return HAL_ERROR;
+    }
 
     Txbuffer[i].buffer = q->payload;
     Txbuffer[i].len = q->len;
@@ -392,46 +561,77 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
       Txbuffer[i-1].next = &Txbuffer[i];
     }
 
-    if(q->next == NULL)
-    {
-      Txbuffer[i].next = NULL;
-    }
-
     i++;
   }
 
+  /* Stopped while the link is down: hold the frame until it comes back */
+  if(heth.gState != HAL_ETH_STATE_STARTED)
+  {
+    return HAL_BUSY;
+  }
+
   TxConfig.Length = p->tot_len;
   TxConfig.TxBuffer = Txbuffer;
   TxConfig.pData = p;
 
+  /* The HAL never clears ErrorCode, a stale BUSY would read as this frame's */
+  heth.ErrorCode = HAL_ETH_ERROR_NONE;
+
+  /* Released by HAL_ETH_TxFreeCallback once the DMA is done with it */
   pbuf_ref(p);
 
-  do
+  if(HAL_ETH_Transmit_IT(&heth, &TxConfig) == HAL_OK)
   {
-    if(HAL_ETH_Transmit_IT(&heth, &TxConfig) == HAL_OK)
-    {
-      errval = ERR_OK;
-    }
-    else
-    {
+    ethernetif_tx_stats.frames++;
+    LINK_STATS_INC(link.xmit);
+    return HAL_OK;
+  }
 
-      if(HAL_ETH_GetError(&heth) & HAL_ETH_ERROR_BUSY)
-      {
-        /* Wait for descriptors to become available */
-        osSemaphoreAcquire(  TxPktSemaphore, ETHIF_TX_TIMEOUT);
-        HAL_ETH_ReleaseTxPacket(&heth);
-        errval = ERR_BUF;
-      }
-      else
-      {
-        /* Other error */
-        pbuf_free(p);
-        errval =  ERR_IF;
-      }
+  pbuf_free(p);
+  if(HAL_ETH_GetError(&heth) & HAL_ETH_ERROR_BUSY)
+  {
+    return HAL_BUSY;
+  }
+  ethernetif_tx_stats.drops++;
+  LINK_STATS_INC(link.drop);
+  return HAL_ERROR;
+}
+
+/**
+ * @brief Releases every completed TX descriptor in one pass, then moves
+ * queued frames into the freed descriptors. The caller holds the tcpip
+ * core lock.
+ */
+static void ethernetif_tx_drain(void)
+{
+  HAL_StatusTypeDef status;
+
+  HAL_ETH_ReleaseTxPacket(&heth);
+  ethernetif_tx_stats.reclaims++;
+
+  while (TxQueueCount > 0U)
+  {
+    status = low_level_transmit(TxQueue[TxQueueHead]);
+    if (status == HAL_BUSY)
+    {
+      break;
     }
-  }while(errval == ERR_BUF);
+    /* Sent or dropped, either way the queue's reference goes */
+    pbuf_free(TxQueue[TxQueueHead]);
+    TxQueueHead = (TxQueueHead + 1U) % ETH_TX_QUEUE_LEN;
+    TxQueueCount--;
+  }
+}
 
-  return errval;
+/**
+ * @brief Drains the TX queue from the interface thread, after a TX complete
+ * interrupt, or from the link thread once the MAC is restarted.
+ */
+static void ethernetif_tx_reclaim(void)
+{
+  LOCK_TCPIP_CORE();
+  ethernetif_tx_drain();
+  UNLOCK_TCPIP_CORE();
 }
 
 /**
@@ -465,24 +665,65 @@ static struct pbuf * low_level_input(struct netif *netif)
  */
 void ethernetif_input(void* argument)
 {
-  struct pbuf *p = NULL;
+  struct pbuf *batch[ETH_RX_BATCH_MAX];
   struct netif *netif = (struct netif *) argument;
+  uint32_t count, i, start, missed;
 
   for( ;; )
   {
     if (osSemaphoreAcquire(RxPktSemaphore, TIME_WAITING_FOR_INPUT) == osOK)
     {
+      if (TxReclaimPending)
+      {
+        TxReclaimPending = 0U;
+        ethernetif_tx_reclaim();
+      }
+
       do
       {
-        p = low_level_input( netif );
-        if (p != NULL)
+        /* Drain the completed frames, then feed them to lwIP under one core lock
+           instead of posting one tcpip mailbox message per frame */
+        start = DWT->CYCCNT;
+        for (count = 0; count < ETH_RX_BATCH_MAX; count++)
         {
-          if (netif->input( p, netif) != ERR_OK )
+          batch[count] = low_level_input( netif );
+          if (batch[count] == NULL)
           {
-            pbuf_free(p);
+            break;
           }
         }
-      } while(p!=NULL);
+        if (count == 0)
+        {
+          break;
+        }
+
+        LOCK_TCPIP_CORE();
+#if LINK_STATS
+        /* Refills fail outside the lock, their count joins lwIP's here */
+        lwip_stats.link.memerr += (STAT_COUNTER)(ethernetif_rx_stats.alloc_drops - RxMemerrCounted);
+        RxMemerrCounted = ethernetif_rx_stats.alloc_drops;
+#endif
+        for (i = 0; i < count; i++)
+        {
+          LINK_STATS_INC(link.recv);
+          if (ethernet_input(batch[i], netif) != ERR_OK)
+          {
+            pbuf_free(batch[i]);
+            ethernetif_rx_stats.input_drops++;
+            LINK_STATS_INC(link.drop);
+          }
+        }
+        UNLOCK_TCPIP_CORE();
+
+        ethernetif_rx_stats.frames += count;
+        ethernetif_rx_stats.batches++;
+        ethernetif_rx_stats.cycles += DWT->CYCCNT - start;
+      } while (count == ETH_RX_BATCH_MAX);
+
+      /* Missed-frame counters clear on read */
+      missed = heth.Instance->DMAMFBOCR;
+      ethernetif_rx_stats.mac_drops += ((missed & ETH_DMAMFBOCR_MFC) >> ETH_DMAMFBOCR_MFC_Pos)
+                                     + ((missed & ETH_DMAMFBOCR_MFA) >> ETH_DMAMFBOCR_MFA_Pos);
     }
   }
 }
@@ -797,7 +1038,7 @@ void ethernet_link_thread(void* argument)
 
   struct netif *netif = (struct netif *) argument;
 /* USER CODE BEGIN ETH link init */
-
+  uint8_t tx_link_up = netif_is_link_up(netif) ? 1U : 0U;
 /* USER CODE END ETH link init */
 
   for(;;)
@@ -852,7 +1093,12 @@ void ethernet_link_thread(void* argument)
   }
 
 /* USER CODE BEGIN ETH link Thread core code for User BSP */
-
+  /* Frames queued while the MAC was stopped have no TX interrupt coming */
+  if(netif_is_link_up(netif) && !tx_link_up)
+  {
+    ethernetif_tx_reclaim();
+  }
+  tx_link_up = netif_is_link_up(netif) ? 1U : 0U;
 /* USER CODE END ETH link Thread core code for User BSP */
 
     osDelay(100);
@@ -872,10 +1118,15 @@ void HAL_ETH_RxAllocateCallback(uint8_t **buff)
     * This must be performed whenever a buffer's allocated because it may be
     * changed by lwIP or the app, e.g., pbuf_free decrements ref. */
     pbuf_alloced_custom(PBUF_RAW, 0, PBUF_REF, p, *buff, ETH_RX_BUF_SIZE);
+    /* The HAL builds this descriptor next: only every ETH_RX_COALESCE_FRAMES-th one
+       interrupts on completion, the receive watchdog covers the others */
+    RxDescBuilt++;
+    heth.RxDescList.ItMode = ((RxDescBuilt % ETH_RX_COALESCE_FRAMES) == 0U) ? 1U : 0U;
   }
   else
   {
     RxAllocStatus = RX_ALLOC_ERROR;
+    ethernetif_rx_stats.alloc_drops++;
     *buff = NULL;
   }
 /* USER CODE END HAL ETH RxAllocateCallback */
@@ -26,7 +26,33 @@
 
 /* Within 'USER CODE' section, code will be kept by default at each generation */
 /* USER CODE BEGIN 0 */
+/* Receive path counters, since boot */
+typedef struct
+{
+  uint32_t irqs;            /* RX complete interrupts taken */
+  uint32_t frames;          /* Frames handed to lwIP */
+  uint32_t batches;         /* Core-lock handoffs carrying those frames */
+  uint32_t input_drops;     /* Frames lwIP rejected */
+  uint32_t alloc_drops;     /* Descriptor refills that found the RX pool empty */
+  uint32_t mac_drops;       /* Frames missed by the MAC or DMA */
+  uint64_t cycles;          /* CPU cycles spent draining and handing over frames */
+} ethernetif_rx_stats_t;
 
+/* Transmit path counters, since boot */
+typedef struct
+{
+  uint32_t frames;          /* Frames given to the DMA */
+  uint32_t queued;          /* Frames that waited for free descriptors */
+  uint32_t drops;           /* Frames dropped: queue full, chain too long or DMA error */
+  uint32_t reclaims;        /* Batched descriptor reclaims */
+  uint32_t queue_max;       /* Deepest the TX queue has been */
+} ethernetif_tx_stats_t;
+
+extern ethernetif_rx_stats_t ethernetif_rx_stats;
+extern ethernetif_tx_stats_t ethernetif_tx_stats;
+
+/* Zero-copy RX buffer pool, its memp stats hold the occupancy high-water mark */
+extern const struct memp_desc memp_RX_POOL;
 /* USER CODE END 0 */
 
 /* Exported functions ------------------------------------------------------- */
@@ -120,6 +120,107 @@
 /*-----------------------------------------------------------------------------*/
 /* USER CODE BEGIN 1 */
 #define LWIP_DHCP           0
+/* Results are sent from the executor task under the core lock */
+#define LWIP_TCPIP_CORE_LOCKING 1
+
+/* Memory profiles: the RX pool, pbuf pools, mailboxes, TX queue and heap are sized
+   together. Build with -DLWIP_MEM_PROFILE=LWIP_MEM_PROFILE_HIGH_BURST to switch, and
+   check the NETMEM_STATS high-water marks against the choice. */
+#define LWIP_MEM_PROFILE_LOW_LATENCY  1   /* Short queues: overload is dropped early instead of waiting */
+#define LWIP_MEM_PROFILE_HIGH_BURST   2   /* Deep pools and queues: absorbs command bursts, costs RAM */
+#ifndef LWIP_MEM_PROFILE
+#define LWIP_MEM_PROFILE              LWIP_MEM_PROFILE_LOW_LATENCY
+#endif
+
+/* Full-size segments for the TCP command channel. The window is what the
+   executor may fall behind by before the sender blocks: at least a full testsQ
+   (16 x 265 byte frames) so small commands keep the queue fed. */
+#define TCP_MSS                     1460
+
+/* Fleet commands on CMD_MULTICAST_GROUP (project_header.h). Build with
+   -DCMD_MULTICAST=0 to leave IGMP and the group out. */
+#ifndef CMD_MULTICAST
+#define CMD_MULTICAST               1
+#endif
+#define LWIP_IGMP                   CMD_MULTICAST
+
+/* Results and metrics published to an MQTT broker (mqtt_telemetry.c). Build with
+   -DMQTT_TELEMETRY=0 to leave it out. The output ring buffer holds a full batch
+   and a metrics message; the telemetry tick needs one more timeout, the client's
+   own cyclic timer another. */
+#ifndef MQTT_TELEMETRY
+#define MQTT_TELEMETRY              1
+#endif
+#if MQTT_TELEMETRY
+#define MQTT_OUTPUT_RINGBUF_SIZE    1024
+#endif
+
+/* iperf2 server on IPERF_PORT (iperf_server.c). Build with -DIPERF_SERVER=0 to
+   leave it out. It uses a listener and up to two connections, a sink and a
+   source, next to the command channel and MQTT; a UDP run adds a timeout. */
+#ifndef IPERF_SERVER
+#define IPERF_SERVER                1
+#endif
+#if IPERF_SERVER
+#define MEMP_NUM_TCP_PCB            8
+#endif
+
+/* Held fleet results share one timeout (main.c) */
+#define MEMP_NUM_SYS_TIMEOUT        (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 2*MQTT_TELEMETRY + IPERF_SERVER + CMD_MULTICAST)
+
+#undef MEM_SIZE
+#undef TCPIP_MBOX_SIZE
+#undef DEFAULT_UDP_RECVMBOX_SIZE
+#if LWIP_MEM_PROFILE == LWIP_MEM_PROFILE_LOW_LATENCY
+#define ETH_RX_BUFFER_CNT           12U     /* Zero-copy RX pool: the descriptors plus one batch */
+#define ETH_TX_QUEUE_LEN            8U      /* Frames held while all TX descriptors are in use */
+#define PBUF_POOL_SIZE              4       /* Not used on the RX path, kept small */
+#define MEMP_NUM_PBUF               16
+#define MEMP_NUM_TCPIP_MSG_INPKT    8
+#define TCPIP_MBOX_SIZE             6
+#define DEFAULT_UDP_RECVMBOX_SIZE   6
+#define MEM_SIZE                    (10*1024)
+#define TCP_WND                     (4*TCP_MSS)
+#elif LWIP_MEM_PROFILE == LWIP_MEM_PROFILE_HIGH_BURST
+#define ETH_RX_BUFFER_CNT           32U
+#define ETH_TX_QUEUE_LEN            32U
+#define PBUF_POOL_SIZE              8
+#define MEMP_NUM_PBUF               32
+#define MEMP_NUM_TCPIP_MSG_INPKT    16
+#define TCPIP_MBOX_SIZE             16
+#define DEFAULT_UDP_RECVMBOX_SIZE   16
+#define MEM_SIZE                    (24*1024)
+#define TCP_WND                     (8*TCP_MSS)
+#else
+#error "Unknown LWIP_MEM_PROFILE"
+#endif
+
+/* The heap and all memp pools, the RX pool included, are placed in .lwip_mem by the
+   linker script instead of a fixed address it knows nothing about. Cache-line aligned
+   because the ETH DMA reads and writes them. */
+#undef LWIP_RAM_HEAP_POINTER
+#undef LWIP_DECLARE_MEMORY_ALIGNED
+#define LWIP_DECLARE_MEMORY_ALIGNED(variable_name, size) \
+  u8_t variable_name[LWIP_MEM_ALIGN_BUFFER(size)] __attribute__((aligned(32), section(".lwip_mem")))
+
+/* Counters for the NET_METRICS snapshot: link, memory and UDP. Each counter has a
+   single writer holding the tcpip core lock (memp under its own protection), the
+   snapshot reads them unlocked, so the hot path pays one increment per event.
+   32 bit so host-side rates survive a wrap between polls. */
+#undef LWIP_STATS
+#define LWIP_STATS          1
+#define LWIP_STATS_LARGE    1
+#define MEM_STATS           1
+#define MEMP_STATS          1
+#define LINK_STATS          1
+#define UDP_STATS           1
+#define ETHARP_STATS        0
+#define IP_STATS            0
+#define IPFRAG_STATS        0
+#define ICMP_STATS          0
+#define IGMP_STATS          0
+#define TCP_STATS           0
+#define SYS_STATS           0
 //#define LWIP_DEBUG          1
 //#define NETIF_DEBUG         LWIP_DBG_ON
 //#define ICMP_DEBUG          LWIP_DBG_ON     // For ping!
@@ -45,6 +45,25 @@
 int errno;
 #endif
 
+#if (osCMSIS >= 0x20000U)
+/*
+  Objects created while the stack boots (tcpip mailbox, mem and core-lock
+  mutexes, tcpip thread) come from static storage, in creation order. Objects
+  created later, or larger than a slot, fall back to the RTOS heap.
+*/
+#define SYS_ARCH_STATIC_MBOXES    1
+#define SYS_ARCH_STATIC_MUTEXES   2
+#define SYS_ARCH_STATIC_THREADS   1
+
+static StaticQueue_t      sys_mboxControlBlock[SYS_ARCH_STATIC_MBOXES];
+static uint8_t            sys_mboxQBuffer[SYS_ARCH_STATIC_MBOXES][TCPIP_MBOX_SIZE * sizeof(void *)];
+static StaticSemaphore_t  sys_mutexControlBlock[SYS_ARCH_STATIC_MUTEXES];
+static StaticSemaphore_t  lwip_sys_mutexControlBlock;
+static StaticTask_t       sys_threadControlBlock[SYS_ARCH_STATIC_THREADS];
+static uint32_t           sys_threadTaskBuffer[SYS_ARCH_STATIC_THREADS][TCPIP_THREAD_STACKSIZE / sizeof(uint32_t)];
+static u8_t sys_mboxes_used, sys_mutexes_used, sys_threads_used;
+#endif
+
 /*-----------------------------------------------------------------------------------*/
 //  Creates an empty mailbox.
 err_t sys_mbox_new(sys_mbox_t *mbox, int size)
@@ -53,7 +72,16 @@ err_t sys_mbox_new(sys_mbox_t *mbox, int size)
   osMessageQDef(QUEUE, size, void *);
   *mbox = osMessageCreate(osMessageQ(QUEUE), NULL);
 #else
-  *mbox = osMessageQueueNew(size, sizeof(void *), NULL);
+  osMessageQueueAttr_t attributes = { .name = NULL };
+  if((sys_mboxes_used < SYS_ARCH_STATIC_MBOXES) && (size <= TCPIP_MBOX_SIZE))
+  {
+    attributes.cb_mem = &sys_mboxControlBlock[sys_mboxes_used];
+    attributes.cb_size = sizeof(StaticQueue_t);
+    attributes.mq_mem = &sys_mboxQBuffer[sys_mboxes_used][0];
+    attributes.mq_size = sizeof(sys_mboxQBuffer[0]);
+    sys_mboxes_used++;
+  }
+  *mbox = osMessageQueueNew(size, sizeof(void *), &attributes);
 #endif
 #if SYS_STATS
   ++lwip_stats.sys.mbox.used;
@@ -381,7 +409,11 @@ void sys_init(void)
 #if (osCMSIS < 0x20000U)
   lwip_sys_mutex = osMutexCreate(osMutex(lwip_sys_mutex));
 #else
-  lwip_sys_mutex = osMutexNew(NULL);
+  const osMutexAttr_t attributes = {
+                        .cb_mem = &lwip_sys_mutexControlBlock,
+                        .cb_size = sizeof(lwip_sys_mutexControlBlock),
+                      };
+  lwip_sys_mutex = osMutexNew(&attributes);
 #endif
 }
 /*-----------------------------------------------------------------------------------*/
@@ -396,7 +428,13 @@ err_t sys_mutex_new(sys_mutex_t *mutex) {
   osMutexDef(MUTEX);
   *mutex = osMutexCreate(osMutex(MUTEX));
 #else
-  *mutex = osMutexNew(NULL);
+  osMutexAttr_t attributes = { .name = NULL };
+  if(sys_mutexes_used < SYS_ARCH_STATIC_MUTEXES)
+  {
+    attributes.cb_mem = &sys_mutexControlBlock[sys_mutexes_used++];
+    attributes.cb_size = sizeof(StaticSemaphore_t);
+  }
+  *mutex = osMutexNew(&attributes);
 #endif
 
   if(*mutex == NULL)
@@ -458,11 +496,19 @@ sys_thread_t sys_thread_new(const char *name, lwip_thread_fn thread , void *arg,
   const osThreadDef_t os_thread_def = { (char *)name, (os_pthread)thread, (osPriority)prio, 0, stacksize};
   return osThreadCreate(&os_thread_def, arg);
 #else
-  const osThreadAttr_t attributes = {
+  osThreadAttr_t attributes = {
                         .name = name,
                         .stack_size = stacksize,
                         .priority = (osPriority_t)prio,
                       };
+  if((sys_threads_used < SYS_ARCH_STATIC_THREADS) && (stacksize <= (int)sizeof(sys_threadTaskBuffer[0])))
+  {
+    attributes.cb_mem = &sys_threadControlBlock[sys_threads_used];
+    attributes.cb_size = sizeof(StaticTask_t);
+    attributes.stack_mem = &sys_threadTaskBuffer[sys_threads_used][0];
+    attributes.stack_size = sizeof(sys_threadTaskBuffer[0]);
+    sys_threads_used++;
+  }
   return osThreadNew(thread, arg, &attributes);
 #endif
 }
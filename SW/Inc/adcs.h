@@ -10,14 +10,51 @@
 #include "stm32f7xx_hal.h" // General HAL header, often includes peripheral specific ones
 
 #include "project_header.h"
+#include "test_abort.h"
 
 extern ADC_HandleTypeDef hadc1;
 extern DAC_HandleTypeDef hdac;
 
+extern DMA_HandleTypeDef hdma_adc1;
+extern DMA_HandleTypeDef hdma_dac1;
+
 extern osSemaphoreId_t AdcSemHandle;
 
 #define TOLERANCE_PERCENT 0.1f
 
+/* Waveform sweep (ADC_SWEEP) parameters */
+#define ADC_SWEEP_SAMPLE_RATE_HZ    200000U // DAC update / ADC sample rate
+#define ADC_SWEEP_SAMPLE_POINT      80U     // ADC trigger position within the DAC period (percent)
+#define ADC_SWEEP_MAX_SAMPLES       4096U   // Capacity of the ADC capture buffer
+#define ADC_SWEEP_MAX_LAG           3U      // Max DAC->ADC pipeline delay searched, in samples
+#define ADC_SWEEP_TOLERANCE         4U      // Allowed error per sample, in ADC codes
+
+/* 12-bit linearity analysis (ADC_LINEARITY) parameters */
+#define ADC_LIN_CODES               4096U   // 12-bit DAC codes swept
+#define ADC_LIN_OVERSAMPLE          16U     // Samples summed per code (must be even, <= 16)
+#define ADC_LIN_SETTLE              4U      // Samples discarded per code (> ADC_SWEEP_MAX_LAG)
+#define ADC_LIN_HOLD                (ADC_LIN_SETTLE + ADC_LIN_OVERSAMPLE)
+#define ADC_LIN_CHUNK_CODES         128U    // Codes per DMA sweep chunk
+#define ADC_LIN_EDGE_CODES          64U     // Codes ignored near each rail (DAC buffer headroom)
+#define ADC_LIN_MAX_OFFSET          32      // Pass limits, in LSB
+#define ADC_LIN_MAX_GAIN_ERROR_PPM  20000
+#define ADC_LIN_MAX_INL             8
+#define ADC_LIN_MAX_DNL             4
+
+/* Multi-channel scan (ADC_SCAN) parameters */
+#define ADC_SCAN_CHANNELS           3U      // VREFINT, temperature sensor, DAC loopback
+#define ADC_SCAN_CAL_VDDA_MV        3300U   // VDDA during factory calibration
+#define ADC_SCAN_TS_CAL1_C          30      // Temperature of TS_CAL1
+#define ADC_SCAN_TS_CAL2_C          110     // Temperature of TS_CAL2
+#define ADC_SCAN_TOLERANCE_MV       50      // Allowed loopback error
+#define ADC_SCAN_VDDA_MIN_MV        2900    // Plausible VDDA range
+#define ADC_SCAN_VDDA_MAX_MV        3600
+#define ADC_SCAN_TEMP_MIN_C         (-40)   // Plausible die temperature range
+#define ADC_SCAN_TEMP_MAX_C         125
+
 Result adc_testing(test_command_t*);
+Result adc_sweep_testing(test_command_t*);
+Result adc_linearity_testing(test_command_t*, test_report_t*);
+Result adc_scan_testing(test_command_t*, test_report_t*);
 
 #endif /* ADCS_P_H_ */
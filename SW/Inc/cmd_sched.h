@@ -0,0 +1,48 @@
+#ifndef CMD_SCHED_H_
+#define CMD_SCHED_H_
+
+#include <stdint.h>
+
+#include "project_header.h"
+
+#define CMD_SCHED_SLOTS         24      // Tests ordered at once, more wait in testsQ in arrival order
+#define CMD_SCHED_AGING_MS      250     // Waiting this long lifts a test by one class
+
+/* Scheduling state of one test, kept inside its queued command */
+typedef struct cmd_sched_entry_t {
+    void* owner;                    // The queued command this entry belongs to
+    uint32_t key;                   // Arrival, later by CMD_SCHED_AGING_MS per class; smallest runs first
+    uint32_t sequence;              // Submission order, breaks ties
+    uint32_t deadline;              // Tick ms it must finish by, 0 for none
+    uint32_t estimate_ms;           // Expected run time, 0 while unknown
+    uint32_t started;               // Tick ms it started running
+    uint8_t priority;               // CMD_PRIORITY_HIGH to CMD_PRIORITY_LOW
+    Peripheral peripheral;          // With iterations, selects the run time estimate
+    uint8_t iterations;
+} cmd_sched_entry_t;
+
+/* Scheduler counters, since boot */
+typedef struct cmd_sched_stats_t {
+    uint32_t late_on_arrival;       // Rejected on submission, the backlog alone misses the deadline
+    uint32_t late_on_start;         // Rejected when dequeued, the wait used up the deadline
+    uint32_t aged;                  // Run ahead of a higher class after waiting
+    uint32_t ready_max;             // Most tests ordered at once
+} cmd_sched_stats_t;
+
+extern cmd_sched_stats_t cmd_sched_stats;
+
+/* Called from the tcpip thread or with its lock held */
+uint8_t cmd_sched_priority(const test_command_t* command, const test_sched_t* sched);
+int cmd_sched_admit(cmd_sched_entry_t* entry, const test_command_t* command, const test_sched_t* sched);
+void cmd_sched_submitted(const cmd_sched_entry_t* entry);
+
+/* Called from the executor only */
+void cmd_sched_put(cmd_sched_entry_t* entry);
+cmd_sched_entry_t* cmd_sched_peek(void);
+cmd_sched_entry_t* cmd_sched_take(void);
+uint32_t cmd_sched_ready(void);
+uint8_t cmd_sched_late(const cmd_sched_entry_t* entry);
+void cmd_sched_begin(cmd_sched_entry_t* entry);
+void cmd_sched_end(const cmd_sched_entry_t* entry, uint8_t completed);
+
+#endif /* CMD_SCHED_H_ */
@@ -0,0 +1,29 @@
+#ifndef CMD_SESSIONS_H_
+#define CMD_SESSIONS_H_
+
+#include <stdint.h>
+
+#include "lwip/ip_addr.h"
+
+#define CMD_SESSIONS        4       // Clients tracked at once, UDP peers and the TCP channel
+#define CMD_SESSION_NONE    0xFF
+
+typedef struct cmd_session_t {
+    ip_addr_t addr;                 // Client address, results go back here
+    u16_t port;
+    uint8_t origin;                 // CMD_ORIGIN_UDP or CMD_ORIGIN_TCP
+    uint8_t open;                   // 0 once closed, the slot frees when nothing is in flight
+    uint16_t in_flight;             // Commands queued or executing
+    uint32_t last_used;             // Submission sequence number, picks the UDP slot to recycle
+} cmd_session_t;
+
+extern cmd_session_t cmd_sessions[CMD_SESSIONS];
+
+/* All of these run in the tcpip thread or with the tcpip core lock held */
+uint8_t cmd_session_open(uint8_t origin, const ip_addr_t* addr, u16_t port);
+void cmd_session_close(uint8_t session);
+int cmd_session_admit(uint8_t session, uint32_t queue_depth);
+void cmd_session_done(uint8_t session);
+uint32_t cmd_session_active(void);
+
+#endif /* CMD_SESSIONS_H_ */
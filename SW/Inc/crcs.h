@@ -0,0 +1,49 @@
+#ifndef CRCS_H_
+#define CRCS_H_
+
+#include <stdint.h>
+#include "cmsis_os.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h" // For semaphore-specific functions and types like SemaphoreHandle_t
+
+#include "stm32f7xx_hal.h" // General HAL header, often includes peripheral specific ones
+
+#include "project_header.h"
+
+#define CRC_DMA_MIN_LENGTH  64U     // Shorter buffers are fed by the CPU
+#define CRC_DMA_TIMEOUT     100U    // ticks
+#define CRC_DMA_MAX_LENGTH  65535U  // Bytes per DMA transfer, NDTR is 16 bits
+
+/* CRC parameters, in the usual catalogue form (polynomial without its top bit) */
+typedef struct crc_config_t {
+    uint32_t polynomial;
+    uint32_t length;                // CRC_POLYLENGTH_32B / 16B / 8B / 7B
+    uint32_t init_value;
+    uint32_t final_xor;             // Applied by crc_finish, the unit has no output XOR
+    uint8_t reflect_input;          // Bit-reverse each input byte
+    uint8_t reflect_output;         // Bit-reverse the result
+} crc_config_t;
+
+/* A stream of chunks that all repeat one transmitted chunk */
+typedef struct crc_stream_t {
+    uint32_t expected;              // Register value expected after the chunks so far
+    uint32_t chunk_term;            // Contribution of one chunk from a zero register
+    uint32_t shift;                 // x^(8 * chunk length) mod P
+    uint32_t chunks;                // Chunks checked
+} crc_stream_t;
+
+extern CRC_HandleTypeDef hcrc;
+extern DMA_HandleTypeDef hdma_crc;
+
+extern const crc_config_t crc_config_default;
+
+HAL_StatusTypeDef crc_configure(const crc_config_t* config);
+void crc_begin(void);
+HAL_StatusTypeDef crc_accumulate(const uint8_t* data, size_t length);
+uint32_t crc_finish(void);
+HAL_StatusTypeDef crc_compute(const uint8_t* data, size_t length, uint32_t* crc);
+HAL_StatusTypeDef crc_stream_begin(crc_stream_t* stream, const uint8_t* chunk, size_t length);
+uint8_t crc_stream_check(crc_stream_t* stream, const uint8_t* chunk, size_t length);
+
+#endif /* CRCS_H_ */
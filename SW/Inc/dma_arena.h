@@ -0,0 +1,21 @@
+#ifndef DMA_ARENA_H_
+#define DMA_ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "stm32f7xx_hal.h" // General HAL header, often includes peripheral specific ones
+
+#include "project_header.h"
+
+#define DMA_ARENA_SIZE      (16U * 1024U)   // Bytes shared by all leased DMA buffers
+
+typedef uint32_t dma_arena_mark_t;
+
+dma_arena_mark_t dma_arena_mark(void);
+void dma_arena_release(dma_arena_mark_t mark);
+uint8_t* dma_arena_lease(size_t size);
+void dma_buffer_clean(const void* buffer, size_t size);
+void dma_buffer_invalidate(void* buffer, size_t size);
+
+#endif /* DMA_ARENA_H_ */
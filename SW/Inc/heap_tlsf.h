@@ -0,0 +1,11 @@
+#ifndef HEAP_TLSF_H_
+#define HEAP_TLSF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "project_header.h"
+
+void heap_get_stats(heap_stats_t* stats);
+
+#endif /* HEAP_TLSF_H_ */
@@ -10,6 +10,9 @@
 #include "stm32f7xx_hal.h" // General HAL header, often includes peripheral specific ones
 
 #include "project_header.h"
+#include "dma_arena.h"
+#include "test_abort.h"
+#include "crcs.h"
 
 #define TIMEOUT 	1000 	// ticks (30  millis).
 
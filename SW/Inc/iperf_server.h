@@ -0,0 +1,13 @@
+#ifndef IPERF_SERVER_H_
+#define IPERF_SERVER_H_
+
+#include <stdint.h>
+
+#include "project_header.h"
+
+extern iperf_stats_t iperf_stats;
+
+/* Runs with the tcpip core lock held */
+void iperf_server_init(void);
+
+#endif /* IPERF_SERVER_H_ */
@@ -0,0 +1,22 @@
+#ifndef MQTT_TELEMETRY_H_
+#define MQTT_TELEMETRY_H_
+
+#include <stdint.h>
+
+#include "project_header.h"
+
+/* Telemetry counters, since boot */
+typedef struct mqtt_telemetry_stats_t {
+    uint32_t connects;          // Broker connections accepted
+    uint32_t published;         // Messages handed to the MQTT client
+    uint32_t publish_errors;    // Publishes refused: disconnected, output buffer or QoS 1 window full
+    uint32_t result_drops;      // Results not batched, the batch was full
+} mqtt_telemetry_stats_t;
+
+extern mqtt_telemetry_stats_t mqtt_telemetry_stats;
+
+/* All of these run with the tcpip core lock held */
+void mqtt_telemetry_init(void (*get_metrics)(net_metrics_t* metrics));
+void mqtt_telemetry_result(result_pro_t result, const test_report_t* report);
+
+#endif /* MQTT_TELEMETRY_H_ */
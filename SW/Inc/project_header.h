@@ -24,6 +24,56 @@ typedef uint8_t Peripheral;
 #define SPI    4
 #define I2C    8
 #define ADC_P  16
+#define SYSTEM_P 0  // Board queries, no peripheral under test
+#define CONTROL_P 0x1F  // Control commands, acted on when they arrive
+
+/*
+ * Test modes: the upper bits of the peripheral byte select an alternative
+ * test for the same peripheral. Mode 0 is the original test.
+ */
+#define PERIPHERAL_MASK     0x1F
+#define TEST_MODE_SHIFT     5
+#define TEST_MODE(mode)     ((mode) << TEST_MODE_SHIFT)
+
+#define HEAP_STATS      (SYSTEM_P | TEST_MODE(1))   // Returns heap_stats_t
+#define BOOT_STATS      (SYSTEM_P | TEST_MODE(2))   // Returns boot_stats_t
+#define SCHED_STATS     (SYSTEM_P | TEST_MODE(3))   // Returns sched_stats_t
+#define NET_STATS       (SYSTEM_P | TEST_MODE(4))   // Returns net_stats_t
+#define NETMEM_STATS    (SYSTEM_P | TEST_MODE(5))   // Returns netmem_stats_t
+#define NET_METRICS     (SYSTEM_P | TEST_MODE(6))   // Returns net_metrics_t, see tools/net_metrics
+#define IPERF_STATS     (SYSTEM_P | TEST_MODE(7))   // Returns iperf_stats_t
+
+#define TIMER_STRESS    (TIMER | TEST_MODE(1))  // High-frequency interrupt burst counting
+#define TIMER_PWM       (TIMER | TEST_MODE(2))  // PWM output to input-capture loopback
+#define TIMER_LIMITS    (TIMER | TEST_MODE(3))  // TIMER with timer_limits_t in the bit pattern
+
+#define ADC_SWEEP       (ADC_P | TEST_MODE(1))  // Timer-triggered DAC->ADC DMA waveform sweep
+#define ADC_LINEARITY   (ADC_P | TEST_MODE(2))  // 12-bit offset/gain/INL/DNL characterization
+#define ADC_SCAN        (ADC_P | TEST_MODE(3))  // DAC loopback + VREFINT + temperature DMA scan
+
+/*
+ * Aborts a test of the same client: bit_pattern holds its test ID (uint32_t,
+ * little-endian), 0 or no pattern aborts the running test whoever sent it.
+ * The running test stops at its next iteration or wait and answers
+ * TEST_ABORTED with a test_abort_report_t. A queued one is answered the
+ * same way, without running, when its turn comes. The abort itself answers
+ * TEST_PASS if the test was running, after that test's TEST_ABORTED, or
+ * TEST_FAIL if not, before the queued test's TEST_ABORTED. Fleet results
+ * keep their reply delays, which may reorder the two.
+ */
+#define CMD_ABORT       (CONTROL_P | TEST_MODE(0))
+
+/*
+ * Priority classes, most urgent first. Aborts and SYSTEM_P queries take
+ * theirs from the command and are answered without waiting for a test.
+ * Tests run one at a time in class order; a test waiting CMD_SCHED_AGING_MS
+ * moves up one class, so a low class is delayed but never starved.
+ */
+#define CMD_PRIORITY_CONTROL    0   // CMD_ABORT
+#define CMD_PRIORITY_HEALTH     1   // SYSTEM_P queries
+#define CMD_PRIORITY_HIGH       2
+#define CMD_PRIORITY_NORMAL     3   // Tests sent without a test_sched_t
+#define CMD_PRIORITY_LOW        4   // Soak tests and other background work
 
 #pragma pack(1)  // Disable padding
 typedef struct test_command_t {
@@ -35,9 +85,25 @@ typedef struct test_command_t {
 } test_command_t;
 #pragma pack()  // Restore default packing
 
+/*
+ * Optional scheduling trailer, right after a full-size test_command_t: the
+ * UDP datagram or TCP frame is then sizeof(test_command_t) +
+ * sizeof(test_sched_t) long. A test that cannot finish by its deadline,
+ * judged from the run times seen so far, is answered TEST_DEADLINE without
+ * running, on arrival or when its turn comes.
+ */
+#pragma pack(1)  // Disable padding
+typedef struct test_sched_t {
+    uint8_t priority;       // CMD_PRIORITY_HIGH, _NORMAL or _LOW, ignored by queries and aborts
+    uint32_t deadline_ms;   // Latest finish, counted from arrival; 0 for none
+} test_sched_t;
+#pragma pack()  // Restore default packing
+
 typedef enum {
 	TEST_ERR = -1,
 	TEST_PASS = 1,
+	TEST_ABORTED = 2,   // Stopped by CMD_ABORT, the report says how far it got
+	TEST_DEADLINE = 3,  // Not run, it would have missed its test_sched_t deadline
 	TEST_FAIL = 0xff
 } Result;
 
@@ -46,8 +112,347 @@ typedef struct result_pro_t {
     uint32_t test_id;                // 4 bytes: Test-ID
     Result test_result;             // bitfield: 1 – test succeeded, 0xff –test failed
 } result_pro_t;
+
+/*
+ * result_pro_t as it is on the wire, 6 bytes: the board's compiler gives
+ * Result the short enum size, int16_t, a host compiler an int. Host tools
+ * parse replies with this instead.
+ */
+typedef struct result_wire_t {
+    uint32_t test_id;
+    int16_t test_result;            // Result
+} result_wire_t;
+#pragma pack()  // Restore default packing
+
+/*
+ * TCP command channel: commands stream in on TCP_COMMAND_PORT, each one
+ * prefixed with its length as a little-endian uint16_t. A command may end
+ * right after the bit pattern it uses, missing bytes read as zero, or carry
+ * a test_sched_t after the full command. Results stream back prefixed the
+ * same way and laid out like the UDP response, in command order within a
+ * priority class. The receive window closes while the executor is behind.
+ */
+#define TCP_COMMAND_PORT        5006
+#define TCP_FRAME_HEADER_LENGTH 2
+#define TCP_COMMAND_MIN_LENGTH  (sizeof(test_command_t) - MAX_BIT_PATTERN_LENGTH)
+#define TCP_COMMAND_MAX_LENGTH  (sizeof(test_command_t) + sizeof(test_sched_t))
+
+/*
+ * Fleet commands: every board joins CMD_MULTICAST_GROUP and accepts UDP
+ * commands sent to it on the command port, so one datagram starts a test on
+ * a whole rack. Results are unicast back to the sender, each board holding
+ * its result back by up to CMD_MULTICAST_JITTER_MS so the replies spread out.
+ */
+#ifndef CMD_MULTICAST_GROUP
+#define CMD_MULTICAST_GROUP     "239.192.50.5"
+#endif
+#define CMD_MULTICAST_JITTER_MS 50
+
+/*
+ * MQTT telemetry: results and NET_METRICS are also published to a broker.
+ * Topics are MQTT_TOPIC_PREFIX/<board>/results and .../metrics, <board> being
+ * the chip's unique ID in hex. A results message is an mqtt_batch_header_t
+ * followed by `records` of mqtt_result_record_t, each followed by its report.
+ * A metrics message is a net_metrics_t.
+ */
+#ifndef MQTT_BROKER_ADDR
+#define MQTT_BROKER_ADDR        "192.168.100.1"
+#endif
+#define MQTT_BROKER_PORT        1883
+#define MQTT_TOPIC_PREFIX       "hwtest"
+#ifndef MQTT_TELEMETRY_QOS
+#define MQTT_TELEMETRY_QOS      1       // 0 or 1
+#endif
+#define MQTT_KEEP_ALIVE_S       30
+#define MQTT_BATCH_MS           200     // Results are batched for this long
+#define MQTT_METRICS_MS         5000
+#define MQTT_RECONNECT_MS       5000
+#define MQTT_BATCH_MAX          512     // Batch bytes, header included
+#define MQTT_BATCH_VERSION      2
+
+#pragma pack(1)  // Disable padding
+typedef struct mqtt_batch_header_t {
+    uint8_t version;                // MQTT_BATCH_VERSION
+    uint8_t records;
+    uint16_t dropped;               // Results lost since the previous batch, the batch was full
+} mqtt_batch_header_t;
+
+typedef struct mqtt_result_record_t {
+    uint32_t test_id;
+    int16_t test_result;            // Result, wide enough to keep TEST_ERR apart from TEST_FAIL
+    uint8_t report_length;          // Report bytes following the record
+} mqtt_result_record_t;
+#pragma pack()  // Restore default packing
+
+/*
+ * Some tests return a report: its bytes follow result_pro_t in the same
+ * response datagram. Servers that only read result_pro_t are unaffected.
+ */
+#define MAX_REPORT_LENGTH   128
+
+typedef struct test_report_t {
+    uint16_t length;                    // Number of valid bytes in data (0 = no report)
+    uint8_t data[MAX_REPORT_LENGTH];    // Test-specific packed report
+} test_report_t;
+
+#pragma pack(1)  // Disable padding
+typedef struct test_abort_report_t {
+    uint32_t iterations_done;       // Completed before the abort
+    uint32_t iterations_requested;
+    uint32_t elapsed_ms;            // From the start of the test to the abort
+} test_abort_report_t;
 #pragma pack()  // Restore default packing
 
-uint32_t calculate_crc(uint8_t *data, size_t length);
+#define ADC_LIN_WORST_CODES 4
+
+#pragma pack(1)  // Disable padding
+typedef struct adc_code_error_t {
+    uint16_t code;                  // DAC code
+    int16_t inl;                    // INL at that code, 1/16 LSB
+} adc_code_error_t;
+
+typedef struct adc_linearity_report_t {
+    int32_t offset;                 // Fitted output at code 0, 1/16 LSB
+    int32_t gain_error_ppm;         // Fitted slope error vs. 1 LSB/code
+    int16_t max_inl;                // Largest |INL|, 1/16 LSB
+    uint16_t max_inl_code;
+    int16_t max_dnl;                // Largest |DNL|, 1/16 LSB
+    uint16_t max_dnl_code;
+    adc_code_error_t worst[ADC_LIN_WORST_CODES];    // Worst codes by |INL|
+} adc_linearity_report_t;
+
+typedef struct adc_scan_report_t {
+    uint16_t vdda_min_mv;           // Lowest VDDA derived from VREFINT
+    uint16_t vdda_max_mv;           // Highest VDDA derived from VREFINT
+    int16_t temperature_c;          // Die temperature at the last scan
+    int16_t max_error_mv;           // Largest VDDA-normalized loopback error
+    uint8_t max_error_iteration;    // Iteration of the largest error
+    uint8_t scans;                  // Scans completed
+} adc_scan_report_t;
+
+/*
+ * TIMER test: the report is timer_jitter_report_t. TIMER_LIMITS runs the same
+ * test with a timer_limits_t in the bit pattern overriding the board's default
+ * limits (0 keeps the default); plain TIMER leaves the pattern alone.
+ */
+typedef struct timer_limits_t {
+    uint16_t max_period_error_ppm;  // Worst single period vs. nominal
+    uint16_t max_jitter_us;         // Longest minus shortest period
+    uint16_t max_latency_us;        // Timer ISR to task wake-up
+} timer_limits_t;
+
+typedef struct timer_jitter_report_t {
+    uint32_t core_clock_hz;         // DWT cycle counter frequency
+    uint32_t expected_period_cycles;
+    uint32_t min_period_cycles;
+    uint32_t max_period_cycles;
+    uint32_t mean_period_cycles;
+    uint32_t jitter_cycles;         // max - min period
+    uint32_t max_period_error_ppm;
+    uint32_t max_latency_cycles;    // Worst ISR-to-task wake latency (scheduler latency)
+    uint32_t mean_latency_cycles;
+    uint16_t samples;               // Periods measured
+} timer_jitter_report_t;
+
+/* TIMER_STRESS: timer_stress_config_t in the bit pattern, timer_stress_report_t in the report */
+typedef struct timer_stress_config_t {
+    uint32_t frequency_hz;          // Target update rate, 0 = use prescaler/period
+    uint16_t prescaler;             // TIM7 PSC when frequency_hz is 0
+    uint16_t period;                // TIM7 ARR when frequency_hz is 0
+    uint32_t pulses;                // Pulses per burst, 0 = board default
+} timer_stress_config_t;
+
+typedef struct timer_stress_report_t {
+    uint32_t frequency_hz;          // Actual rate after prescaler/period rounding
+    uint16_t prescaler;
+    uint16_t period;
+    uint32_t pulses;                // Pulses counted per burst
+    uint32_t max_missed;            // Worst updates not serviced within a burst
+    uint32_t min_rate_hz;           // Lowest serviced interrupt rate over the bursts
+    uint8_t bursts;                 // Bursts completed
+} timer_stress_report_t;
+
+/* TIMER_PWM: timer_pwm_config_t in the bit pattern, timer_pwm_report_t in the report. Duty unit is 1/100 % */
+typedef struct timer_pwm_config_t {
+    uint32_t frequency_hz;          // Commanded PWM frequency
+    uint16_t duty;                  // Commanded duty cycle, 1..9999
+    uint16_t periods;               // Periods measured per run, 0 = board default
+    uint16_t max_frequency_error_ppm;   // 0 = board default
+    uint16_t max_duty_error;            // 0 = board default
+} timer_pwm_config_t;
+
+typedef struct timer_pwm_report_t {
+    uint32_t generated_frequency_mhz;   // Generator frequency after rounding, millihertz
+    uint32_t measured_frequency_mhz;    // Last run, millihertz
+    uint16_t generated_duty;            // Generator duty after rounding
+    uint16_t measured_duty;             // Last run
+    uint32_t max_frequency_error_ppm;   // Worst run vs. commanded frequency
+    uint16_t max_duty_error;            // Worst run vs. commanded duty
+    uint16_t min_period_ticks;          // Shortest / longest single period, capture timer ticks
+    uint16_t max_period_ticks;
+    uint16_t periods;                   // Periods measured per run
+    uint8_t runs;                       // Runs completed
+} timer_pwm_report_t;
+
+typedef struct heap_stats_t {
+    uint32_t total_bytes;           // Heap payload capacity
+    uint32_t free_bytes;
+    uint32_t min_ever_free_bytes;
+    uint32_t largest_free_block;
+    uint16_t fragmentation_permille;    // 1000 * (1 - largest / free)
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t failures;              // Allocations that returned NULL
+    uint32_t alloc_cycles_max;      // pvPortMalloc latency, CPU cycles
+    uint32_t alloc_cycles_avg;
+    uint32_t free_cycles_max;       // vPortFree latency, CPU cycles
+    uint32_t free_cycles_avg;
+} heap_stats_t;
+
+typedef struct boot_stats_t {
+    uint32_t ready_cycles;          // CPU cycles from reset to command socket bound, sleep not counted
+    uint32_t ready_us;              // Reset to command socket bound, sleep included
+    uint32_t kernel_start_us;       // Reset to the scheduler start
+    uint32_t heap_allocations;      // Heap allocations made before ready
+    uint32_t heap_free_bytes;       // Heap free when ready
+} boot_stats_t;
+
+typedef struct sched_stats_t {
+    uint32_t uptime_ms;             // RTOS ticks since the scheduler started
+    uint32_t context_switches;      // Task switch-ins since boot
+    uint32_t sleeps;                // Tickless idle sleeps entered since boot
+    uint32_t executor_wake_cycles_last;     // Command hand-off to an idle executor running, CPU cycles
+    uint32_t executor_wake_cycles_max;
+    uint32_t probe_wait_us_last;    // Health query hand-off to its answer starting, microseconds
+    uint32_t probe_wait_us_max;
+    uint32_t deadline_rejects;      // Tests answered TEST_DEADLINE, on arrival or when dequeued
+    uint32_t aged;                  // Tests run ahead of a higher class after waiting
+} sched_stats_t;
+
+typedef struct net_stats_t {
+    uint32_t responses;             // Results sent
+    uint32_t response_errors;       // Results that could not be sent
+    uint32_t response_allocs;       // Sends that allocated a pbuf, the reusable one was still queued
+    uint32_t response_cycles_avg;   // Reused pbuf, CPU cycles per result
+    uint32_t response_cycles_max;
+    uint32_t response_alloc_cycles_avg;     // Allocated pbuf, CPU cycles per result
+    uint32_t rx_irqs;               // RX interrupts taken, after coalescing
+    uint32_t rx_frames;             // Frames handed to lwIP
+    uint32_t rx_batches;            // Core-lock handoffs carrying those frames
+    uint32_t rx_input_drops;        // Frames lwIP rejected
+    uint32_t rx_alloc_drops;        // RX pool empty on descriptor refill
+    uint32_t rx_mac_drops;          // Frames missed by the MAC or DMA
+    uint32_t rx_cycles_per_frame;   // CPU cycles per frame, drain and handoff
+    uint32_t tx_frames;             // Frames given to the DMA
+    uint32_t tx_queued;             // Frames that waited for free descriptors
+    uint32_t tx_drops;              // Queue full, chain too long or DMA error
+    uint32_t tx_reclaims;           // Batched descriptor reclaims
+    uint32_t tx_queue_max;          // Deepest TX queue seen
+    uint32_t uptime_ms;             // Sample time, frames/s from two samples
+    uint32_t tcp_connections;       // TCP command channel clients accepted
+    uint32_t tcp_commands;          // Commands received over TCP
+    uint32_t tcp_results;           // Results written back over TCP
+    uint32_t tcp_stalls;            // Times testsQ was full and the window closed
+    uint32_t tcp_result_drops;      // Client gone or send buffer full
+    uint32_t mqtt_connects;         // MQTT broker connections accepted
+    uint32_t mqtt_published;        // Telemetry messages handed to the MQTT client
+    uint32_t mqtt_publish_errors;   // Broker down or output buffer full, retried later
+    uint32_t mqtt_result_drops;     // Results not published, the batch was full
+} net_stats_t;
+
+typedef struct netmem_stats_t {
+    uint32_t profile;               // LWIP_MEM_PROFILE the image was built with
+    uint32_t rx_pool_size;          // Zero-copy RX buffers
+    uint32_t rx_pool_max;           // Most RX buffers in use at once
+    uint32_t rx_pool_errors;        // Refills that found the RX pool empty
+    uint32_t pbuf_ref_size;         // PBUF_REF/ROM headers, results and TX chains
+    uint32_t pbuf_ref_max;
+    uint32_t pbuf_ref_errors;
+    uint32_t pbuf_pool_size;        // PBUF_POOL buffers
+    uint32_t pbuf_pool_max;
+    uint32_t pbuf_pool_errors;
+    uint32_t inpkt_size;            // tcpip_input messages
+    uint32_t inpkt_max;
+    uint32_t inpkt_errors;
+    uint32_t heap_size;             // lwIP heap, bytes
+    uint32_t heap_max;              // Most heap bytes in use at once
+    uint32_t heap_errors;           // Failed heap allocations
+    uint32_t tcpip_mbox_size;       // tcpip thread mailbox depth
+    uint32_t tx_queue_size;         // Frames the TX queue holds
+    uint32_t tx_queue_max;
+} netmem_stats_t;
+
+/*
+ * NET_METRICS: where commands are lost, from the wire to the executor queue.
+ * Counters run since boot, "used" and "depth" fields are current levels.
+ */
+typedef struct net_metrics_t {
+    uint32_t uptime_ms;             // Sample time, rates from two samples
+    uint32_t link_up;               // 1 when the PHY reports link
+    uint32_t link_recv;             // Frames received by the interface
+    uint32_t link_xmit;             // Frames sent by the interface
+    uint32_t link_drop;             // Frames dropped by the interface, either direction
+    uint32_t link_err;              // Short frames and RX pool exhaustion
+    uint32_t eth_rx_irqs;           // RX DMA interrupts, after coalescing
+    uint32_t eth_rx_mac_drops;      // Frames the MAC or DMA missed
+    uint32_t eth_rx_alloc_drops;    // Descriptor refills that found the RX pool empty
+    uint32_t eth_tx_queued;         // Frames that waited for TX descriptors
+    uint32_t eth_tx_drops;          // TX queue full, chain too long or DMA error
+    uint32_t rx_pool_used;          // Zero-copy RX buffers held by the DMA or lwIP
+    uint32_t pbuf_ref_used;         // PBUF_REF/ROM headers
+    uint32_t pbuf_ref_errors;
+    uint32_t pbuf_pool_used;        // PBUF_POOL buffers
+    uint32_t pbuf_pool_errors;
+    uint32_t mem_used;              // lwIP heap bytes
+    uint32_t mem_errors;
+    uint32_t udp_recv;              // Datagrams into UDP
+    uint32_t udp_xmit;              // Datagrams out of UDP
+    uint32_t udp_drop;              // Bad length or checksum, no socket bound
+    uint32_t udp_errors;            // No route or no memory for the headers
+    uint32_t cmdq_enqueued;         // Commands handed to the executor
+    uint32_t cmdq_full;             // Commands rejected, testsQ full
+    uint32_t cmdq_rejected;         // Commands rejected, too short or no memory
+    uint32_t cmdq_depth;            // Tests waiting to run, in testsQ or ordered
+    uint32_t cmdq_depth_max;        // Most tests seen waiting
+    uint32_t cmdq_quota;            // Commands rejected, client over its share of testsQ
+    uint32_t sessions_active;       // Clients with commands in flight
+    uint32_t cache_replays;         // Resent commands answered from the result cache
+    uint32_t cache_coalesced;       // Resent commands dropped, the original still running
+} net_metrics_t;
+
+/*
+ * IPERF_STATS: the last run of the on-board iperf2 server on IPERF_PORT.
+ *   iperf -c <board> [-r | -d]     TCP sink, -r/-d add the board as a source
+ *   iperf -c <board> -u -b 50M     UDP sink, loss and jitter in the server report
+ */
+#define IPERF_PORT          5001
+#define IPERF_TCP_SINK      1
+#define IPERF_TCP_SOURCE    2
+#define IPERF_UDP_SINK      3
+
+typedef struct iperf_stats_t {
+    uint32_t runs;                  // Runs finished since boot
+    uint32_t active;                // Runs in progress
+    uint32_t mode;                  // Last run: IPERF_TCP_SINK, IPERF_TCP_SOURCE or IPERF_UDP_SINK
+    uint32_t bytes;                 // Payload bytes moved
+    uint32_t duration_ms;
+    uint32_t kbit_per_s;
+    uint32_t cpu_load_permille;     // Time outside the idle task, whole CPU, over the run
+    uint32_t datagrams;             // UDP: datagrams received
+    uint32_t lost;                  // UDP: gaps in the sequence numbers
+    uint32_t out_of_order;          // UDP: datagrams that arrived after a later one
+    uint32_t jitter_us;             // UDP: RFC 1889 interarrival jitter
+} iperf_stats_t;
+#pragma pack()  // Restore default packing
+
+/**
+ * @brief Macro for 32-byte alignment to match Cortex-M7 Cache line size.
+ */
+#define ALIGN_32 __attribute__((aligned(32)))
+
+/**
+ * @brief Macro to round length up to the nearest 32-byte boundary for cache maintenance.
+ */
+#define CACHE_ROUND(x) (((x) + 31) & ~31)
 
 #endif
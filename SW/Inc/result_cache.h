@@ -0,0 +1,37 @@
+#ifndef RESULT_CACHE_H_
+#define RESULT_CACHE_H_
+
+#include <stdint.h>
+
+#include "lwip/ip_addr.h"
+
+#include "project_header.h"
+
+#define RESULT_CACHE_ENTRIES    32      // Results remembered, in flight or done; >= testsQ length
+#define RESULT_CACHE_BUCKETS    32      // Hash index size, a power of two
+#define RESULT_CACHE_MAX_AGE_MS 10000   // A finished result older than this is not replayed
+
+typedef enum {
+    RESULT_CACHE_MISS = 0,      // New command, now tracked as in flight (or untracked if full)
+    RESULT_CACHE_IN_FLIGHT,     // Duplicate of a command still queued or running
+    RESULT_CACHE_DONE           // Duplicate of a finished command, its result is cached
+} result_cache_state_t;
+
+/* Cache counters, since boot */
+typedef struct result_cache_stats_t {
+    uint32_t replays;           // Duplicates answered from the cache
+    uint32_t coalesced;         // Duplicates of a command in flight, dropped
+    uint32_t evictions;         // Finished results pushed out by newer commands
+    uint32_t expired;           // Finished results dropped for their age, the command ran again
+    uint32_t untracked;         // Commands run without an entry, all were in flight
+} result_cache_stats_t;
+
+extern result_cache_stats_t result_cache_stats;
+
+/* All of these run in the tcpip thread or with the tcpip core lock held */
+result_cache_state_t result_cache_claim(const ip_addr_t* addr, u16_t port, uint32_t test_id,
+                                        const result_pro_t** result, const test_report_t** report);
+void result_cache_release(const ip_addr_t* addr, u16_t port, uint32_t test_id);
+void result_cache_complete(const ip_addr_t* addr, u16_t port, result_pro_t result, const test_report_t* report);
+
+#endif /* RESULT_CACHE_H_ */
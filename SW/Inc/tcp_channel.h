@@ -0,0 +1,26 @@
+#ifndef TCP_CHANNEL_H_
+#define TCP_CHANNEL_H_
+
+#include <stdint.h>
+
+#include "project_header.h"
+
+#define TCP_RESULT_HOLD_MS  2       // A result waits to share a segment only for a test expected to end this soon
+
+/* Command channel counters, since boot */
+typedef struct tcp_channel_stats_t {
+    uint32_t connections;       // Clients accepted
+    uint32_t commands;          // Commands handed to the executor
+    uint32_t results;           // Results written back
+    uint32_t stalls;            // Parses stopped by a full queue or held results, the window closes
+    uint32_t held;              // Results kept back by a full send buffer, written later
+    uint32_t result_drops;      // Results for a closed connection, or no memory to hold them
+} tcp_channel_stats_t;
+
+extern tcp_channel_stats_t tcp_channel_stats;
+
+/* All of these run with the tcpip core lock held */
+void tcp_channel_init(void);
+int tcp_channel_send_result(result_pro_t result, const test_report_t* report, uint32_t tag, uint8_t more);
+
+#endif /* TCP_CHANNEL_H_ */
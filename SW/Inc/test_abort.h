@@ -0,0 +1,30 @@
+#ifndef TEST_ABORT_H_
+#define TEST_ABORT_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include "project_header.h"
+
+#define TEST_ABORT_CANCELLED    8       // Aborted commands remembered until they leave testsQ
+#define TEST_ABORT_HELD         4       // Abort answers held back behind the aborted test's result
+
+/* Called from the tcpip thread or with its lock held */
+Result test_abort_request(uint8_t session, uint32_t test_id);
+
+/* Called from the executor around each test */
+void test_abort_begin(uint8_t session, const test_command_t* command);
+uint8_t test_abort_end(test_report_t* report);
+uint8_t test_abort_cancelled(uint8_t session, uint32_t test_id);
+void* test_abort_reported(void);
+
+/* Called from probe_task with the answer of an abort that found its test running */
+uint8_t test_abort_hold(void* answer);
+
+/* Called from the tests: iteration boundaries and wait points */
+uint8_t test_checkpoint(uint32_t iterations_done);
+BaseType_t test_wait(SemaphoreHandle_t semaphore, TickType_t timeout);
+
+#endif /* TEST_ABORT_H_ */
@@ -10,12 +10,43 @@
 #include "stm32f7xx_hal.h" // General HAL header, often includes peripheral specific ones
 
 #include "project_header.h"
+#include "test_abort.h"
 
 #define TIMEOUT 	1000
 
+/* Default limits, used when the command does not supply timer_limits_t */
+#define TIMER_MAX_PERIOD_ERROR_PPM  1000    // Worst single period vs. nominal
+#define TIMER_MAX_JITTER_US         50      // Longest minus shortest period
+#define TIMER_MAX_LATENCY_US        100     // TIM7 callback to task wake-up
+
+/* Stress test (TIMER_STRESS) parameters */
+#define TIMER_STRESS_MAX_FREQUENCY_HZ   1000000U    // Highest accepted target rate
+#define TIMER_STRESS_DEFAULT_PULSES     10000U      // Burst length when not commanded
+#define TIMER_STRESS_MAX_MISSED         1U          // Allowed missed pulses per burst
+
+/* PWM loopback (TIMER_PWM) parameters */
+#define TIMER_PWM_MAX_FREQUENCY_HZ          500000U // Highest accepted PWM frequency
+#define TIMER_PWM_MAX_PERIODS               2048U   // Capacity of the capture buffer
+#define TIMER_PWM_DEFAULT_PERIODS           2048U   // Periods measured when not commanded
+#define TIMER_PWM_DISCARD                   2U      // Start-up captures dropped
+#define TIMER_PWM_CAPTURE_MAX_TICKS         60000U  // Capture counts per period, below 16-bit overflow
+#define TIMER_PWM_DUTY_SCALE                10000U  // Duty cycle unit: 1/100 percent
+#define TIMER_PWM_MAX_FREQUENCY_ERROR_PPM   2000U   // Default limits
+#define TIMER_PWM_MAX_DUTY_ERROR            50U
+
 extern TIM_HandleTypeDef htim7;
 extern osSemaphoreId_t TimSemHandle;
 
-Result timer_testing(test_command_t*);
+extern volatile uint32_t tim7_isr_cycles;
+extern volatile uint32_t timer_stress_target;
+extern DMA_HandleTypeDef hdma_tim1_ch1;
+
+Result timer_testing(test_command_t*, test_report_t*);
+Result timer_stress_testing(test_command_t*, test_report_t*);
+Result timer_pwm_testing(test_command_t*, test_report_t*);
+void timer_stress_pulse_from_isr(void);
+uint32_t timer_apb1_clock(void);
+uint32_t timer_apb2_clock(void);
+void dwt_cycle_counter_init(void);
 
 #endif /* TIMERS_H_ */
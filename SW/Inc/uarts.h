@@ -11,6 +11,9 @@
 #include "stm32f7xx_hal_uart.h" // Specifically for UART_HandleTypeDef and HAL_UART functions
 
 #include "project_header.h"
+#include "dma_arena.h"
+#include "test_abort.h"
+#include "crcs.h"
 
 #define TIMEOUT 	1000 	// ticks (30  millis).
 
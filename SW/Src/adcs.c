@@ -12,6 +12,44 @@
  */
 
 #include "adcs.h"
+#include "timer_test.h"
+
+extern DMA_HandleTypeDef hdma_i2c4_tx;
+
+/*
+ * Waveform sweep resources.
+ * TIM2 paces the sweep: its update event (TRGO) latches the next DAC sample,
+ * and its CC2 event, later in the same period, triggers the ADC conversion.
+ * ADC1 results are moved by DMA2 Stream4. The DAC1 request only exists on
+ * DMA1 Stream5, which is shared with I2C4_TX, so the stream is borrowed for
+ * the duration of the sweep and handed back to I2C4 afterwards.
+ */
+DMA_HandleTypeDef hdma_adc1;
+DMA_HandleTypeDef hdma_dac1;
+static TIM_HandleTypeDef htim2;
+
+static ADC_InitTypeDef adc_saved_init;
+
+static uint8_t sweep_wave[MAX_BIT_PATTERN_LENGTH] ALIGN_32;
+static uint16_t sweep_capture[ADC_SWEEP_MAX_SAMPLES] ALIGN_32;
+
+/* Scan sequence results, in rank order: VREFINT, temperature sensor, DAC loopback */
+static uint16_t scan_result[ADC_SCAN_CHANNELS] ALIGN_32;
+
+/* Linearity analysis buffers: one chunk of held DAC codes, and the per-code sums */
+static uint16_t lin_wave[ADC_LIN_CHUNK_CODES * ADC_LIN_HOLD] ALIGN_32;
+static uint16_t lin_code_sum[ADC_LIN_CODES];
+
+static HAL_StatusTypeDef adc_sweep_init(void);
+static HAL_StatusTypeDef adc_sweep_start(const void* wave, uint16_t wave_len, uint32_t dac_align,
+                                         uint32_t samples, uint32_t resolution);
+static void adc_sweep_stop(void);
+static uint32_t adc_sweep_find_lag(uint16_t wave_len, uint32_t samples);
+static uint32_t adc_sum_oversampled(const uint16_t* samples);
+static HAL_StatusTypeDef adc_scan_configure(void);
+static void adc_scan_restore(void);
+static void adc_linearity_analyse(adc_linearity_report_t* summary);
+static int16_t adc_lin_saturate(int32_t value);
 
 /**
  * @brief Performs a hardware verification test on the ADC peripheral.
@@ -39,6 +77,9 @@ Result adc_testing(test_command_t* command) {
     }
 
     for (uint8_t i = 0; i < command->iterations; i++) {
+        if (test_checkpoint(i)) {
+            return TEST_ABORTED;
+        }
         /* * Use pattern data for expected value. If iterations exceed pattern length,
          * the last available pattern byte continues to be used.
          */
@@ -51,6 +92,9 @@ Result adc_testing(test_command_t* command) {
         HAL_DAC_SetValue(&hdac, DAC_CHANNEL_1, DAC_ALIGN_8B_R, expected_adc_result);
         HAL_Delay(1);
 
+        // Drain a stale completion, an aborted test may have left one
+        xSemaphoreTake(AdcSemHandle, 0);
+
         // Start ADC conversion in Interrupt mode
         status = HAL_ADC_Start_IT(&hadc1);
         if (status != HAL_OK) {
@@ -59,7 +103,7 @@ Result adc_testing(test_command_t* command) {
         }
 
         // Wait for ADC conversion completion signaled by ISR semaphore
-        if (xSemaphoreTake(AdcSemHandle, HAL_MAX_DELAY) == pdPASS) {
+        if (test_wait(AdcSemHandle, HAL_MAX_DELAY) == pdPASS) {
             adc_value = HAL_ADC_GetValue(&hadc1);
         } else {
             HAL_ADC_Stop(&hadc1);
@@ -88,8 +132,623 @@ Result adc_testing(test_command_t* command) {
     return TEST_PASS;
 }
 
+/**
+ * @brief Performs a timer-paced DAC->ADC waveform sweep using DMA on both sides.
+ * * The DAC replays the command's bit pattern (or a full 0..255 ramp when the
+ * pattern is empty) from a circular DMA buffer while the ADC samples every
+ * step in lockstep into a capture buffer. The CPU only verifies the capture
+ * once the whole sweep has completed.
+ * * @param command Pointer to the test_command_t structure; iterations is the
+ * number of times the waveform is replayed.
+ * @return Result TEST_PASS if every captured sample is within tolerance,
+ * TEST_FAIL on mismatch or timeout, TEST_ERR for invalid input.
+ */
+Result adc_sweep_testing(test_command_t* command) {
+    uint16_t wave_len;
+    uint32_t samples;
+    uint32_t lag;
+    int32_t difference;
+    Result result = TEST_PASS;
+
+    if (command == NULL) {
+        return TEST_ERR;
+    }
+
+    // Use the pattern as waveform, or a full-scale ramp if none is given
+    if (command->bit_pattern_length > 0) {
+        wave_len = command->bit_pattern_length;
+        memcpy(sweep_wave, command->bit_pattern, wave_len);
+    } else {
+        wave_len = MAX_BIT_PATTERN_LENGTH;
+        for (uint16_t i = 0; i < wave_len; i++) {
+            sweep_wave[i] = (uint8_t)i;
+        }
+    }
+
+    samples = (uint32_t)wave_len * command->iterations + ADC_SWEEP_MAX_LAG;
+    if (samples > ADC_SWEEP_MAX_SAMPLES) {
+        samples = ADC_SWEEP_MAX_SAMPLES;
+    }
+
+    // Push the waveform to RAM and drop stale lines over the capture buffer
+    SCB_CleanDCache_by_Addr((uint32_t*)sweep_wave, CACHE_ROUND(wave_len));
+    SCB_InvalidateDCache_by_Addr((uint32_t*)sweep_capture, CACHE_ROUND(samples * sizeof(uint16_t)));
+
+    if (adc_sweep_init() != HAL_OK) {
+        return TEST_FAIL;
+    }
+
+    // Drain a stale completion left over from a previous test
+    xSemaphoreTake(AdcSemHandle, 0);
+
+    if (adc_sweep_start(sweep_wave, wave_len, DAC_ALIGN_8B_R, samples, ADC_RESOLUTION_8B) != HAL_OK) {
+        adc_sweep_stop();
+        return TEST_FAIL;
+    }
+
+    // The whole sweep runs in hardware; wait for the ADC DMA to complete
+    if (test_wait(AdcSemHandle, pdMS_TO_TICKS(samples * 1000U / ADC_SWEEP_SAMPLE_RATE_HZ + TIMEOUT)) != pdPASS) {
+        result = TEST_FAIL;
+    }
+
+    adc_sweep_stop();
+
+    if (result != TEST_PASS) {
+        return result;
+    }
+
+    SCB_InvalidateDCache_by_Addr((uint32_t*)sweep_capture, CACHE_ROUND(samples * sizeof(uint16_t)));
+
+    // Verify every captured sample against the waveform step it belongs to
+    lag = adc_sweep_find_lag(wave_len, samples);
+    for (uint32_t k = lag; k < samples; k++) {
+        difference = (int32_t)sweep_capture[k] - (int32_t)sweep_wave[(k - lag) % wave_len];
+        if (difference < 0) {
+            difference = -difference;
+        }
+        if (difference > ADC_SWEEP_TOLERANCE) {
+            return TEST_FAIL;
+        }
+    }
+
+    return TEST_PASS;
+}
+
+/**
+ * @brief Multi-channel scan test with VREFINT-normalized DAC loopback.
+ * * Each iteration sets the DAC from the pattern (as adc_testing does) and runs
+ * one 12-bit scan of VREFINT, the temperature sensor and the loopback channel
+ * into a DMA buffer, raising one interrupt per scan. VREFINT and its factory
+ * calibration give the actual VDDA, so the loopback reading is checked in
+ * millivolts against a fixed tolerance instead of a percentage of the code.
+ * The internal channels are converted first: their long sampling time also
+ * lets the DAC output settle before the loopback channel is sampled.
+ * * @param command Pointer to the test_command_t structure.
+ * @param report Receives an adc_scan_report_t summary.
+ * @return Result TEST_PASS if every scan is within limits, TEST_FAIL otherwise,
+ * TEST_ERR for invalid input.
+ */
+Result adc_scan_testing(test_command_t* command, test_report_t* report) {
+    adc_scan_report_t summary = {0};
+    uint32_t sensors_on = ADC->CCR & ADC_CCR_TSVREFE;
+    uint32_t dac_code = 0;
+    int32_t vdda_mv, loop_mv, expected_mv, temperature, error_mv;
+    Result result = TEST_PASS;
+
+    if (command == NULL || report == NULL) {
+        return TEST_ERR;
+    }
+
+    // ADC1 is untouched until adc_scan_configure() has saved its settings
+    if (adc_sweep_init() != HAL_OK) {
+        return TEST_FAIL;
+    }
+    if (adc_scan_configure() != HAL_OK) {
+        adc_scan_restore();
+        return TEST_FAIL;
+    }
+    // Just powered by TSVREFE, the sensor and VREFINT need their t_START.
+    // Two ticks, one could end at once
+    if (!sensors_on) {
+        osDelay(2);
+    }
+
+    if (HAL_DAC_Start(&hdac, DAC_CHANNEL_1) != HAL_OK) {
+        adc_scan_restore();
+        return TEST_FAIL;
+    }
+
+    summary.vdda_min_mv = UINT16_MAX;
+
+    for (uint8_t i = 0; i < command->iterations; i++) {
+        if (test_checkpoint(i)) {
+            result = TEST_ABORTED;
+            break;
+        }
+        // Same pattern semantics as adc_testing: the last byte repeats
+        if (i < command->bit_pattern_length) {
+            dac_code = (uint32_t)command->bit_pattern[i] << 4;
+        }
+        HAL_DAC_SetValue(&hdac, DAC_CHANNEL_1, DAC_ALIGN_12B_R, dac_code);
+
+        SCB_InvalidateDCache_by_Addr((uint32_t*)scan_result, CACHE_ROUND(sizeof(scan_result)));
+        xSemaphoreTake(AdcSemHandle, 0);
+
+        if (HAL_ADC_Start_DMA(&hadc1, (uint32_t*)scan_result, ADC_SCAN_CHANNELS) != HAL_OK) {
+            result = TEST_FAIL;
+            break;
+        }
+        if (test_wait(AdcSemHandle, TIMEOUT) != pdPASS) {
+            HAL_ADC_Stop_DMA(&hadc1);
+            result = TEST_FAIL;
+            break;
+        }
+        HAL_ADC_Stop_DMA(&hadc1);
+        SCB_InvalidateDCache_by_Addr((uint32_t*)scan_result, CACHE_ROUND(sizeof(scan_result)));
+
+        if (scan_result[0] == 0) {
+            result = TEST_FAIL;
+            break;
+        }
+
+        // VDDA from VREFINT and its factory calibration (taken at 3.3 V)
+        vdda_mv = (int32_t)(ADC_SCAN_CAL_VDDA_MV * (uint32_t)(*VREFINT_CAL_ADDR_CMSIS) / scan_result[0]);
+
+        // Temperature, with the raw reading rescaled to the 3.3 V calibration conditions
+        temperature = (int32_t)scan_result[1] * vdda_mv / (int32_t)ADC_SCAN_CAL_VDDA_MV;
+        temperature = ADC_SCAN_TS_CAL1_C +
+                      (temperature - (int32_t)*TEMPSENSOR_CAL1_ADDR_CMSIS) * (ADC_SCAN_TS_CAL2_C - ADC_SCAN_TS_CAL1_C) /
+                      ((int32_t)*TEMPSENSOR_CAL2_ADDR_CMSIS - (int32_t)*TEMPSENSOR_CAL1_ADDR_CMSIS);
+
+        // Loopback in absolute millivolts
+        loop_mv = (int32_t)scan_result[2] * vdda_mv / 4095;
+        expected_mv = (int32_t)dac_code * vdda_mv / 4095;
+        error_mv = loop_mv - expected_mv;
+        if (error_mv < 0) {
+            error_mv = -error_mv;
+        }
+
+        if (vdda_mv < summary.vdda_min_mv) {
+            summary.vdda_min_mv = (uint16_t)vdda_mv;
+        }
+        if (vdda_mv > summary.vdda_max_mv) {
+            summary.vdda_max_mv = (uint16_t)vdda_mv;
+        }
+        if (error_mv > summary.max_error_mv) {
+            summary.max_error_mv = (int16_t)error_mv;
+            summary.max_error_iteration = i;
+        }
+        summary.temperature_c = (int16_t)temperature;
+        summary.scans++;
+
+        if (error_mv > ADC_SCAN_TOLERANCE_MV ||
+            vdda_mv < ADC_SCAN_VDDA_MIN_MV || vdda_mv > ADC_SCAN_VDDA_MAX_MV ||
+            temperature < ADC_SCAN_TEMP_MIN_C || temperature > ADC_SCAN_TEMP_MAX_C) {
+            result = TEST_FAIL;
+        }
+    }
+
+    adc_scan_restore();
+
+    memcpy(report->data, &summary, sizeof(summary));
+    report->length = sizeof(summary);
+
+    return result;
+}
+
+/**
+ * @brief Reconfigures ADC1 for a 12-bit, three-rank scan with one DMA request per conversion.
+ */
+static HAL_StatusTypeDef adc_scan_configure(void) {
+    ADC_ChannelConfTypeDef sConfig = {0};
+
+    HAL_ADC_Stop(&hadc1);
+    adc_saved_init = hadc1.Init;
+
+    hadc1.Init.Resolution = ADC_RESOLUTION_12B;
+    hadc1.Init.ScanConvMode = ADC_SCAN_ENABLE;
+    hadc1.Init.NbrOfConversion = ADC_SCAN_CHANNELS;
+    hadc1.Init.EOCSelection = ADC_EOC_SEQ_CONV;
+    if (HAL_ADC_Init(&hadc1) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    // Internal channels need >= 10 us of sampling
+    sConfig.Channel = ADC_CHANNEL_VREFINT;
+    sConfig.Rank = ADC_REGULAR_RANK_1;
+    sConfig.SamplingTime = ADC_SAMPLETIME_480CYCLES;
+    if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    sConfig.Channel = ADC_CHANNEL_TEMPSENSOR;
+    sConfig.Rank = ADC_REGULAR_RANK_2;
+    if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    sConfig.Channel = ADC_CHANNEL_10;
+    sConfig.Rank = ADC_REGULAR_RANK_3;
+    sConfig.SamplingTime = ADC_SAMPLETIME_56CYCLES;
+    return HAL_ADC_ConfigChannel(&hadc1, &sConfig);
+}
+
+/**
+ * @brief Restores the single-channel ADC1 setup used by adc_testing.
+ */
+static void adc_scan_restore(void) {
+    ADC_ChannelConfTypeDef sConfig = {0};
+
+    HAL_ADC_Stop_DMA(&hadc1);
+
+    hadc1.Init = adc_saved_init;
+    HAL_ADC_Init(&hadc1);
+
+    sConfig.Channel = ADC_CHANNEL_10;
+    sConfig.Rank = ADC_REGULAR_RANK_1;
+    sConfig.SamplingTime = ADC_SAMPLETIME_3CYCLES;
+    HAL_ADC_ConfigChannel(&hadc1, &sConfig);
+}
+
+/**
+ * @brief Characterizes the 12-bit DAC->ADC transfer function on the device.
+ * * Every DAC code is held for ADC_LIN_HOLD timer-paced samples; the first
+ * ADC_LIN_SETTLE samples of each hold are discarded and the remaining
+ * ADC_LIN_OVERSAMPLE are summed. The sweep runs in chunks of
+ * ADC_LIN_CHUNK_CODES codes through the same TIM2/DMA machinery as
+ * adc_sweep_testing. Offset, gain error, INL and DNL are then computed with
+ * fixed-point arithmetic, and only the summary is reported to the server.
+ * * @param command Pointer to the test_command_t structure (pattern unused).
+ * @param report Receives an adc_linearity_report_t summary.
+ * @return Result TEST_PASS if all figures are within the ADC_LIN_MAX_* limits,
+ * TEST_FAIL if a limit is exceeded or the sweep times out, TEST_ERR for invalid input.
+ */
+Result adc_linearity_testing(test_command_t* command, test_report_t* report) {
+    adc_linearity_report_t summary;
+    uint32_t samples = ADC_LIN_CHUNK_CODES * ADC_LIN_HOLD;
+
+    if (command == NULL || report == NULL) {
+        return TEST_ERR;
+    }
+
+    if (adc_sweep_init() != HAL_OK) {
+        return TEST_FAIL;
+    }
+
+    for (uint32_t first_code = 0; first_code < ADC_LIN_CODES; first_code += ADC_LIN_CHUNK_CODES) {
+        // Hold every code of the chunk for ADC_LIN_HOLD DAC updates
+        for (uint32_t c = 0; c < ADC_LIN_CHUNK_CODES; c++) {
+            for (uint32_t r = 0; r < ADC_LIN_HOLD; r++) {
+                lin_wave[c * ADC_LIN_HOLD + r] = (uint16_t)(first_code + c);
+            }
+        }
+        SCB_CleanDCache_by_Addr((uint32_t*)lin_wave, sizeof(lin_wave));
+        SCB_InvalidateDCache_by_Addr((uint32_t*)sweep_capture, CACHE_ROUND(samples * sizeof(uint16_t)));
+
+        xSemaphoreTake(AdcSemHandle, 0);
+
+        if (adc_sweep_start(lin_wave, samples, DAC_ALIGN_12B_R, samples, ADC_RESOLUTION_12B) != HAL_OK) {
+            adc_sweep_stop();
+            return TEST_FAIL;
+        }
+        if (test_wait(AdcSemHandle, pdMS_TO_TICKS(samples * 1000U / ADC_SWEEP_SAMPLE_RATE_HZ + TIMEOUT)) != pdPASS) {
+            adc_sweep_stop();
+            return TEST_FAIL;
+        }
+        adc_sweep_stop();
+
+        SCB_InvalidateDCache_by_Addr((uint32_t*)sweep_capture, CACHE_ROUND(samples * sizeof(uint16_t)));
+
+        for (uint32_t c = 0; c < ADC_LIN_CHUNK_CODES; c++) {
+            lin_code_sum[first_code + c] =
+                (uint16_t)adc_sum_oversampled(&sweep_capture[c * ADC_LIN_HOLD + ADC_LIN_SETTLE]);
+        }
+    }
+
+    adc_linearity_analyse(&summary);
+
+    memcpy(report->data, &summary, sizeof(summary));
+    report->length = sizeof(summary);
+
+    if (summary.offset > ADC_LIN_MAX_OFFSET * ADC_LIN_OVERSAMPLE ||
+        summary.offset < -ADC_LIN_MAX_OFFSET * ADC_LIN_OVERSAMPLE ||
+        summary.gain_error_ppm > ADC_LIN_MAX_GAIN_ERROR_PPM ||
+        summary.gain_error_ppm < -ADC_LIN_MAX_GAIN_ERROR_PPM ||
+        summary.max_inl > ADC_LIN_MAX_INL * ADC_LIN_OVERSAMPLE ||
+        summary.max_dnl > ADC_LIN_MAX_DNL * ADC_LIN_OVERSAMPLE) {
+        return TEST_FAIL;
+    }
+    return TEST_PASS;
+}
+
+/**
+ * @brief Sums ADC_LIN_OVERSAMPLE 12-bit samples two at a time with the
+ * Cortex-M7 SIMD unit. Each 16-bit lane adds at most 8 samples of 4095,
+ * so neither lane can overflow.
+ * @param samples Word-aligned pointer to the samples.
+ */
+static uint32_t adc_sum_oversampled(const uint16_t* samples) {
+    const uint32_t* pairs = (const uint32_t*)samples;
+    uint32_t lanes = 0;
+
+    for (uint32_t i = 0; i < ADC_LIN_OVERSAMPLE / 2U; i++) {
+        lanes = __UADD16(lanes, pairs[i]);
+    }
+    return (lanes & 0xFFFFU) + (lanes >> 16);
+}
+
+/**
+ * @brief Fits a least-squares line through the per-code sums and derives
+ * offset, gain error, INL and DNL in fixed point.
+ * All levels are kept in 1/ADC_LIN_OVERSAMPLE LSB units, as summed.
+ * Codes within ADC_LIN_EDGE_CODES of either rail are excluded, because the
+ * buffered DAC output cannot swing fully to the supply rails.
+ */
+static void adc_linearity_analyse(adc_linearity_report_t* summary) {
+    const int32_t first = ADC_LIN_EDGE_CODES;
+    const int32_t last = ADC_LIN_CODES - ADC_LIN_EDGE_CODES;
+    int64_t n = last - first;
+    int64_t sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int64_t numerator, denominator;
+    int64_t gain_q16;       // fitted slope in (1/OVERSAMPLE LSB) per code, Q16
+    int32_t offset;         // fitted level at code 0
+    int32_t inl, previous_inl = 0, dnl;
+    int32_t max_inl = 0, max_dnl = 0;
+
+    for (int32_t code = first; code < last; code++) {
+        int64_t y = lin_code_sum[code];
+        sx += code;
+        sy += y;
+        sxx += (int64_t)code * code;
+        sxy += (int64_t)code * y;
+    }
+
+    numerator = n * sxy - sx * sy;
+    denominator = n * sxx - sx * sx;
+
+    // Scale both terms down until the Q16 shift of the numerator fits in 64 bits
+    while (numerator > (INT64_MAX >> 17) || numerator < -(INT64_MAX >> 17)) {
+        numerator /= 2;
+        denominator /= 2;
+    }
+    gain_q16 = (numerator << 16) / denominator;
+    offset = (int32_t)((sy - ((gain_q16 * sx) >> 16)) / n);
+
+    memset(summary, 0, sizeof(*summary));
+    summary->offset = offset;
+    summary->gain_error_ppm =
+        (int32_t)(((gain_q16 - ((int64_t)ADC_LIN_OVERSAMPLE << 16)) * 1000000) / ((int64_t)ADC_LIN_OVERSAMPLE << 16));
+
+    for (int32_t code = first; code < last; code++) {
+        int32_t ideal = offset + (int32_t)((gain_q16 * code) >> 16);
+        int32_t magnitude;
+
+        inl = (int32_t)lin_code_sum[code] - ideal;
+        magnitude = (inl < 0) ? -inl : inl;
+
+        if (magnitude > max_inl) {
+            max_inl = magnitude;
+            summary->max_inl = adc_lin_saturate(magnitude);
+            summary->max_inl_code = (uint16_t)code;
+        }
+
+        // Keep the worst codes sorted by |INL|, largest first
+        for (uint32_t w = 0; w < ADC_LIN_WORST_CODES; w++) {
+            int32_t held = summary->worst[w].inl;
+            if (magnitude > ((held < 0) ? -held : held)) {
+                memmove(&summary->worst[w + 1], &summary->worst[w],
+                        (ADC_LIN_WORST_CODES - 1U - w) * sizeof(summary->worst[0]));
+                summary->worst[w].code = (uint16_t)code;
+                summary->worst[w].inl = adc_lin_saturate(inl);
+                break;
+            }
+        }
+
+        // DNL: deviation of this step from the fitted step
+        if (code > first) {
+            dnl = inl - previous_inl;
+            magnitude = (dnl < 0) ? -dnl : dnl;
+            if (magnitude > max_dnl) {
+                max_dnl = magnitude;
+                summary->max_dnl = adc_lin_saturate(magnitude);
+                summary->max_dnl_code = (uint16_t)code;
+            }
+        }
+        previous_inl = inl;
+    }
+}
+
+/**
+ * @brief Clamps a level to the report's int16_t. A full-scale error is
+ * 65520 in 1/16 LSB and would otherwise wrap to a small, passing value.
+ */
+static int16_t adc_lin_saturate(int32_t value) {
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    }
+    return (value < INT16_MIN) ? INT16_MIN : (int16_t)value;
+}
+
+/**
+ * @brief One-time setup of the sweep timer and the ADC DMA stream.
+ */
+static HAL_StatusTypeDef adc_sweep_init(void) {
+    TIM_MasterConfigTypeDef sMasterConfig = {0};
+    TIM_OC_InitTypeDef sConfigOC = {0};
+    uint32_t timer_clock = timer_apb1_clock();
+
+    if (htim2.Instance != NULL) {
+        return HAL_OK;
+    }
+
+    __HAL_RCC_TIM2_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    htim2.Instance = TIM2;
+    htim2.Init.Prescaler = 0;
+    htim2.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim2.Init.Period = timer_clock / ADC_SWEEP_SAMPLE_RATE_HZ - 1U;
+    htim2.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_PWM_Init(&htim2) != HAL_OK) {
+        htim2.Instance = NULL;
+        return HAL_ERROR;
+    }
+
+    // Update event -> DAC trigger
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    HAL_TIMEx_MasterConfigSynchronization(&htim2, &sMasterConfig);
+
+    // CC2 event -> ADC trigger, once the DAC output has settled
+    sConfigOC.OCMode = TIM_OCMODE_PWM1;
+    sConfigOC.Pulse = (htim2.Init.Period + 1U) * ADC_SWEEP_SAMPLE_POINT / 100U;
+    sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+    sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+    HAL_TIM_PWM_ConfigChannel(&htim2, &sConfigOC, TIM_CHANNEL_2);
+
+    // ADC1 -> memory
+    hdma_adc1.Instance = DMA2_Stream4;
+    hdma_adc1.Init.Channel = DMA_CHANNEL_0;
+    hdma_adc1.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_adc1.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_adc1.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_adc1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_adc1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_adc1.Init.Mode = DMA_NORMAL;
+    hdma_adc1.Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_adc1.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_adc1) != HAL_OK) {
+        htim2.Instance = NULL;
+        return HAL_ERROR;
+    }
+    __HAL_LINKDMA(&hadc1, DMA_Handle, hdma_adc1);
+
+    HAL_NVIC_SetPriority(DMA2_Stream4_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream4_IRQn);
+
+    // Memory -> DAC1, configured here and claimed per sweep
+    hdma_dac1.Instance = DMA1_Stream5;
+    hdma_dac1.Init.Channel = DMA_CHANNEL_7;
+    hdma_dac1.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_dac1.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_dac1.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_dac1.Init.Mode = DMA_CIRCULAR;
+    hdma_dac1.Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_dac1.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    __HAL_LINKDMA(&hdac, DMA_Handle1, hdma_dac1);
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Switches ADC and DAC to TIM2 triggers and starts both DMA streams and the timer.
+ * @param wave DAC samples, bytes for DAC_ALIGN_8B_R or half-words for DAC_ALIGN_12B_R.
+ * @param wave_len Number of DAC samples, replayed circularly.
+ * @param dac_align DAC data alignment matching the wave element size.
+ * @param samples Number of ADC samples to capture into sweep_capture.
+ * @param resolution ADC resolution for the capture.
+ */
+static HAL_StatusTypeDef adc_sweep_start(const void* wave, uint16_t wave_len, uint32_t dac_align,
+                                         uint32_t samples, uint32_t resolution) {
+    DAC_ChannelConfTypeDef sConfig = {0};
+    uint32_t last_value;
+
+    // ADC: hardware trigger on TIM2 CC2
+    HAL_ADC_Stop(&hadc1);
+    adc_saved_init = hadc1.Init;
+    hadc1.Init.Resolution = resolution;
+    hadc1.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T2_CC2;
+    hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+    if (HAL_ADC_Init(&hadc1) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    // DAC: hardware trigger on TIM2 TRGO, preloaded with the last step so the
+    // first update already outputs a waveform value
+    HAL_DAC_Stop(&hdac, DAC_CHANNEL_1);
+    sConfig.DAC_Trigger = DAC_TRIGGER_T2_TRGO;
+    sConfig.DAC_OutputBuffer = DAC_OUTPUTBUFFER_ENABLE;
+    if (HAL_DAC_ConfigChannel(&hdac, &sConfig, DAC_CHANNEL_1) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    if (dac_align == DAC_ALIGN_8B_R) {
+        last_value = ((const uint8_t*)wave)[wave_len - 1];
+        hdma_dac1.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+        hdma_dac1.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    } else {
+        last_value = ((const uint16_t*)wave)[wave_len - 1];
+        hdma_dac1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+        hdma_dac1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    }
+    HAL_DAC_SetValue(&hdac, DAC_CHANNEL_1, dac_align, last_value);
+
+    // Borrow DMA1 Stream5 from I2C4_TX
+    if (HAL_DMA_Init(&hdma_dac1) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    if (HAL_ADC_Start_DMA(&hadc1, (uint32_t*)sweep_capture, samples) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    if (HAL_DAC_Start_DMA(&hdac, DAC_CHANNEL_1, (uint32_t*)wave, wave_len, dac_align) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    __HAL_TIM_SET_COUNTER(&htim2, 0);
+    return HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_2);
+}
+
+/**
+ * @brief Stops the sweep and restores the software-triggered ADC/DAC setup used by adc_testing.
+ */
+static void adc_sweep_stop(void) {
+    DAC_ChannelConfTypeDef sConfig = {0};
+
+    HAL_TIM_PWM_Stop(&htim2, TIM_CHANNEL_2);
+    HAL_DAC_Stop_DMA(&hdac, DAC_CHANNEL_1);
+    HAL_ADC_Stop_DMA(&hadc1);
+
+    if (hadc1.Init.ExternalTrigConv != ADC_SOFTWARE_START) {
+        hadc1.Init = adc_saved_init;
+        HAL_ADC_Init(&hadc1);
+    }
+
+    sConfig.DAC_Trigger = DAC_TRIGGER_NONE;
+    sConfig.DAC_OutputBuffer = DAC_OUTPUTBUFFER_ENABLE;
+    HAL_DAC_ConfigChannel(&hdac, &sConfig, DAC_CHANNEL_1);
+
+    // Hand DMA1 Stream5 back to I2C4_TX
+    HAL_DMA_DeInit(&hdma_dac1);
+    HAL_DMA_Init(&hdma_i2c4_tx);
+}
+
+/**
+ * @brief Finds the DAC->ADC pipeline delay, in samples, that best aligns the capture with the waveform.
+ */
+static uint32_t adc_sweep_find_lag(uint16_t wave_len, uint32_t samples) {
+    uint32_t best_lag = 0;
+    uint32_t best_error = UINT32_MAX;
+    uint32_t window = (wave_len < 64U) ? wave_len : 64U;
+
+    for (uint32_t lag = 0; lag <= ADC_SWEEP_MAX_LAG; lag++) {
+        uint32_t error = 0;
+
+        for (uint32_t k = ADC_SWEEP_MAX_LAG; k < ADC_SWEEP_MAX_LAG + window && k < samples; k++) {
+            int32_t difference = (int32_t)sweep_capture[k] - (int32_t)sweep_wave[(k - lag) % wave_len];
+            error += (difference < 0) ? -difference : difference;
+        }
+        if (error < best_error) {
+            best_error = error;
+            best_lag = lag;
+        }
+    }
+    return best_lag;
+}
+
 /**
  * @brief ADC Conversion Complete Callback.
+ * Also raised when a sweep's DMA capture buffer is full.
  * @param hadc Pointer to the ADC handle triggering the interrupt.
  */
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
@@ -0,0 +1,229 @@
+/**
+ * @file cmd_sched.c
+ * @brief Priority classes with aging and deadline checks for queued tests.
+ */
+
+#include "cmd_sched.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define NOW_MS()    (xTaskGetTickCount() * portTICK_PERIOD_MS)
+
+cmd_sched_stats_t cmd_sched_stats;
+
+static cmd_sched_entry_t* heap[CMD_SCHED_SLOTS];
+static uint32_t heap_count;
+static uint32_t estimate_us[256];   // Per iteration, by peripheral byte, 0 until first seen
+static uint32_t pending_ms[CMD_PRIORITY_LOW + 1];   // Estimated work submitted but not dequeued
+static uint32_t running_until;      // Estimated end of the running test
+static uint8_t running;
+static uint32_t sequence;
+
+/**
+ * @brief Heap order: smaller key first, then earlier submission. Wrap-safe.
+ */
+static int cmd_sched_before(const cmd_sched_entry_t* a, const cmd_sched_entry_t* b) {
+    int32_t d = (int32_t)(a->key - b->key);
+
+    return d < 0 || (d == 0 && (int32_t)(a->sequence - b->sequence) < 0);
+}
+
+static uint32_t cmd_sched_estimate(Peripheral peripheral, uint8_t iterations) {
+    return (uint32_t)(((uint64_t)estimate_us[peripheral] * iterations + 999U) / 1000U);
+}
+
+/**
+ * @brief Picks the class of a command.
+ * @param sched The command's trailer, NULL when it had none.
+ * @return CMD_PRIORITY_CONTROL or _HEALTH for aborts and queries, which the
+ * probe task answers; the requested class, HIGH to LOW, for tests.
+ */
+uint8_t cmd_sched_priority(const test_command_t* command, const test_sched_t* sched) {
+    if (command->peripheral == CMD_ABORT) {
+        return CMD_PRIORITY_CONTROL;
+    }
+    if ((command->peripheral & PERIPHERAL_MASK) == SYSTEM_P) {
+        return CMD_PRIORITY_HEALTH;
+    }
+    if (sched == NULL) {
+        return CMD_PRIORITY_NORMAL;
+    }
+    // The reserved classes would let a test pass for a query
+    if (sched->priority < CMD_PRIORITY_HIGH) {
+        return CMD_PRIORITY_HIGH;
+    }
+    return (sched->priority > CMD_PRIORITY_LOW) ? CMD_PRIORITY_LOW : sched->priority;
+}
+
+/**
+ * @brief Fills in a test's entry and checks its deadline against the backlog.
+ * @param sched The command's trailer, NULL when it had none.
+ * @return 0 when the test can be queued, -1 when it would miss its deadline.
+ */
+int cmd_sched_admit(cmd_sched_entry_t* entry, const test_command_t* command, const test_sched_t* sched) {
+    uint32_t now = NOW_MS();
+    uint32_t backlog = 0;
+    uint8_t p;
+
+    entry->priority = cmd_sched_priority(command, sched);
+    entry->peripheral = command->peripheral;
+    entry->iterations = command->iterations;
+    entry->key = now + (entry->priority - CMD_PRIORITY_HIGH) * CMD_SCHED_AGING_MS;
+    entry->sequence = ++sequence;
+    entry->estimate_ms = cmd_sched_estimate(command->peripheral, command->iterations);
+    entry->deadline = 0;
+
+    if (sched == NULL || sched->deadline_ms == 0) {
+        return 0;
+    }
+    // 0 means no deadline, a deadline landing on it is moved by a millisecond
+    entry->deadline = now + sched->deadline_ms;
+    if (entry->deadline == 0) {
+        entry->deadline = 1;
+    }
+
+    taskENTER_CRITICAL();
+    if (running && (int32_t)(running_until - now) > 0) {
+        backlog = running_until - now;
+    }
+    for (p = CMD_PRIORITY_HIGH; p <= entry->priority; p++) {
+        backlog += pending_ms[p];
+    }
+    taskEXIT_CRITICAL();
+
+    if ((int32_t)(now + backlog + entry->estimate_ms - entry->deadline) > 0) {
+        cmd_sched_stats.late_on_arrival++;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Counts an admitted test in the backlog, once it is in testsQ.
+ */
+void cmd_sched_submitted(const cmd_sched_entry_t* entry) {
+    taskENTER_CRITICAL();
+    pending_ms[entry->priority] += entry->estimate_ms;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Adds a test taken from testsQ. The caller checks cmd_sched_ready()
+ * against CMD_SCHED_SLOTS first.
+ */
+void cmd_sched_put(cmd_sched_entry_t* entry) {
+    uint32_t i = heap_count++;
+
+    while (i > 0 && cmd_sched_before(entry, heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = entry;
+
+    if (heap_count > cmd_sched_stats.ready_max) {
+        cmd_sched_stats.ready_max = heap_count;
+    }
+}
+
+/**
+ * @brief The test that runs next, left in place. NULL when none is waiting.
+ */
+cmd_sched_entry_t* cmd_sched_peek(void) {
+    return (heap_count > 0) ? heap[0] : NULL;
+}
+
+/**
+ * @brief Removes the test that runs next and takes it out of the backlog.
+ * @return The entry, or NULL when none is waiting.
+ */
+cmd_sched_entry_t* cmd_sched_take(void) {
+    cmd_sched_entry_t* top;
+    cmd_sched_entry_t* last;
+    uint32_t i = 0;
+    uint32_t child;
+
+    if (heap_count == 0) {
+        return NULL;
+    }
+    top = heap[0];
+
+    for (child = 1; child < heap_count; child++) {
+        if (heap[child]->priority < top->priority) {
+            cmd_sched_stats.aged++;
+            break;
+        }
+    }
+
+    last = heap[--heap_count];
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= heap_count) {
+            break;
+        }
+        if (child + 1 < heap_count && cmd_sched_before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!cmd_sched_before(heap[child], last)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+
+    taskENTER_CRITICAL();
+    pending_ms[top->priority] -= top->estimate_ms;
+    taskEXIT_CRITICAL();
+    return top;
+}
+
+/**
+ * @brief Tests ordered and waiting, not counting those still in testsQ.
+ */
+uint32_t cmd_sched_ready(void) {
+    return heap_count;
+}
+
+/**
+ * @brief Tells whether a dequeued test can no longer finish by its deadline.
+ */
+uint8_t cmd_sched_late(const cmd_sched_entry_t* entry) {
+    if (entry->deadline == 0 || (int32_t)(NOW_MS() + entry->estimate_ms - entry->deadline) <= 0) {
+        return 0;
+    }
+    cmd_sched_stats.late_on_start++;
+    return 1;
+}
+
+/**
+ * @brief Marks a test as running, its estimate now delays new arrivals.
+ */
+void cmd_sched_begin(cmd_sched_entry_t* entry) {
+    entry->started = NOW_MS();
+
+    taskENTER_CRITICAL();
+    running_until = entry->started + entry->estimate_ms;
+    running = 1;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Ends a test and learns its run time.
+ * @param completed 0 when the test was aborted, its time says nothing.
+ */
+void cmd_sched_end(const cmd_sched_entry_t* entry, uint8_t completed) {
+    uint32_t sample;
+    uint32_t* estimate = &estimate_us[entry->peripheral];
+
+    taskENTER_CRITICAL();
+    running = 0;
+    taskEXIT_CRITICAL();
+
+    if (!completed) {
+        return;
+    }
+    sample = (uint32_t)(((uint64_t)(NOW_MS() - entry->started) * 1000U) / entry->iterations);
+    // Moving average over about four runs, the first run sets it
+    *estimate = (*estimate == 0) ? sample : (uint32_t)(((uint64_t)*estimate * 3U + sample) / 4U);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file cmd_sessions.c
+ * @brief Table of command clients, keyed by transport, address and port.
+ */
+
+#include "cmd_sessions.h"
+
+#include "main.h"
+
+cmd_session_t cmd_sessions[CMD_SESSIONS];
+
+static uint32_t use_sequence;
+
+/**
+ * @brief Finds the client's session or opens one for it.
+ * @return The session index, or CMD_SESSION_NONE when every slot is busy.
+ */
+uint8_t cmd_session_open(uint8_t origin, const ip_addr_t* addr, u16_t port) {
+    uint8_t victim = CMD_SESSION_NONE;
+    uint8_t i;
+
+    for (i = 0; i < CMD_SESSIONS; i++) {
+        cmd_session_t* s = &cmd_sessions[i];
+
+        if (s->open && s->origin == origin && s->port == port && ip_addr_cmp(&s->addr, addr)) {
+            s->last_used = ++use_sequence;
+            return i;
+        }
+        // Free slots first, then the least recently used idle UDP client
+        if (s->in_flight == 0 && (!s->open || s->origin == CMD_ORIGIN_UDP)) {
+            if (victim == CMD_SESSION_NONE
+                || (cmd_sessions[victim].open && (!s->open || s->last_used < cmd_sessions[victim].last_used))) {
+                victim = i;
+            }
+        }
+    }
+
+    if (victim != CMD_SESSION_NONE) {
+        cmd_session_t* s = &cmd_sessions[victim];
+
+        ip_addr_copy(s->addr, *addr);
+        s->port = port;
+        s->origin = origin;
+        s->open = 1;
+        s->last_used = ++use_sequence;
+    }
+    return victim;
+}
+
+/**
+ * @brief Ends a session. Results still in flight are dropped by the transport.
+ */
+void cmd_session_close(uint8_t session) {
+    if (session < CMD_SESSIONS) {
+        cmd_sessions[session].open = 0;
+    }
+}
+
+/**
+ * @brief Takes one place in the queue for the session, within its fair share.
+ * @details The share only bounds how many of its commands a client has in
+ * flight. Admitted tests still run in class and arrival order, so a light
+ * client waits behind what a heavy one queued before it.
+ * @param queue_depth Commands the executor queue holds in total.
+ * @return 0 when admitted, -1 when the session already holds its share.
+ */
+int cmd_session_admit(uint8_t session, uint32_t queue_depth) {
+    cmd_session_t* s = &cmd_sessions[session];
+    uint32_t active = cmd_session_active();
+    uint32_t share;
+
+    // This session counts as active from its first command
+    if (s->in_flight == 0) {
+        active++;
+    }
+    share = queue_depth / active;
+    if (share == 0) {
+        share = 1;
+    }
+
+    if (s->in_flight >= share) {
+        return -1;
+    }
+    s->in_flight++;
+    return 0;
+}
+
+/**
+ * @brief Releases the session's place once the result is sent or dropped.
+ */
+void cmd_session_done(uint8_t session) {
+    if (session < CMD_SESSIONS && cmd_sessions[session].in_flight > 0) {
+        cmd_sessions[session].in_flight--;
+    }
+}
+
+/**
+ * @brief Counts the sessions with commands in flight.
+ */
+uint32_t cmd_session_active(void) {
+    uint32_t active = 0;
+    uint8_t i;
+
+    for (i = 0; i < CMD_SESSIONS; i++) {
+        if (cmd_sessions[i].in_flight > 0) {
+            active++;
+        }
+    }
+    return active;
+}
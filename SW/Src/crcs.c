@@ -0,0 +1,314 @@
+/**
+ * @file crcs.c
+ * @brief CRC service on top of the CRC unit, fed by memory-to-memory DMA.
+ * * Design Decision:
+ * The CRC unit is configured for byte input, so any length is processed
+ * exactly, with no read past the end of the buffer. Buffers of at least
+ * CRC_DMA_MIN_LENGTH bytes are written to CRC->DR by DMA2 Stream7 while the
+ * calling task blocks on a semaphore; shorter ones are fed by the CPU, where
+ * the DMA set-up would cost more than it saves.
+ * A CRC is built with crc_begin(), any number of crc_accumulate() calls and
+ * crc_finish(), so a digest can span several chunks. The unit has one state:
+ * only one accumulation may be in progress at a time.
+ * * Streams: the unit's register after a message is affine in its starting
+ * value, R' = R * x^(8n) mod P + C, where C only depends on the message. For a
+ * stream that repeats one chunk, crc_stream_begin() derives C and x^(8n)
+ * from a single CRC of the chunk, after which the expected register for every
+ * further chunk costs one 32-bit carry-less multiply on the CPU. Each received
+ * chunk is CRC'd once, chained onto the previous ones, and compared against
+ * the expectation, so the final register covers the whole stream.
+ */
+
+#include "crcs.h"
+
+/* The CRC-32 of the CubeMX setup: 0x04C11DB7, init 0xFFFFFFFF, no reflection, no final XOR */
+const crc_config_t crc_config_default = {
+    .polynomial = DEFAULT_CRC32_POLY,
+    .length = CRC_POLYLENGTH_32B,
+    .init_value = DEFAULT_CRC_INITVALUE,
+    .final_xor = 0,
+    .reflect_input = 0,
+    .reflect_output = 0,
+};
+
+DMA_HandleTypeDef hdma_crc;
+
+static uint32_t crc_final_xor;
+static uint32_t crc_mask = 0xFFFFFFFFU;
+
+/* Active parameters, needed for the stream arithmetic */
+static uint32_t crc_polynomial = DEFAULT_CRC32_POLY;
+static uint32_t crc_width = 32U;
+static uint32_t crc_init_value = DEFAULT_CRC_INITVALUE;
+static uint8_t crc_reflected;
+
+static SemaphoreHandle_t crc_dma_sem;
+static StaticSemaphore_t crc_dma_sem_buffer;
+
+static HAL_StatusTypeDef crc_dma_init(void);
+static HAL_StatusTypeDef crc_accumulate_chunk(const uint8_t* data, size_t length);
+static void crc_dma_complete(DMA_HandleTypeDef* hdma);
+static uint32_t crc_mulmod(uint32_t a, uint32_t b);
+static uint32_t crc_xpow(uint32_t exponent);
+
+/**
+ * @brief Reprograms the CRC unit with new parameters and resets it.
+ * @param config CRC parameters, NULL for crc_config_default.
+ * @return HAL_OK, or HAL_ERROR for an invalid polynomial.
+ */
+HAL_StatusTypeDef crc_configure(const crc_config_t* config) {
+    if (config == NULL) {
+        config = &crc_config_default;
+    }
+
+    hcrc.Init.DefaultPolynomialUse = DEFAULT_POLYNOMIAL_DISABLE;
+    hcrc.Init.GeneratingPolynomial = config->polynomial;
+    hcrc.Init.CRCLength = config->length;
+    hcrc.Init.DefaultInitValueUse = DEFAULT_INIT_VALUE_DISABLE;
+    hcrc.Init.InitValue = config->init_value;
+    hcrc.Init.InputDataInversionMode = config->reflect_input ? CRC_INPUTDATA_INVERSION_BYTE
+                                                             : CRC_INPUTDATA_INVERSION_NONE;
+    hcrc.Init.OutputDataInversionMode = config->reflect_output ? CRC_OUTPUTDATA_INVERSION_ENABLE
+                                                               : CRC_OUTPUTDATA_INVERSION_DISABLE;
+    hcrc.InputDataFormat = CRC_INPUTDATA_FORMAT_BYTES;
+    if (HAL_CRC_Init(&hcrc) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    switch (config->length) {
+    case CRC_POLYLENGTH_7B:  crc_width = 7U; break;
+    case CRC_POLYLENGTH_8B:  crc_width = 8U; break;
+    case CRC_POLYLENGTH_16B: crc_width = 16U; break;
+    default:                 crc_width = 32U; break;
+    }
+    crc_mask = (crc_width == 32U) ? 0xFFFFFFFFU : ((1U << crc_width) - 1U);
+    crc_final_xor = config->final_xor & crc_mask;
+    crc_polynomial = config->polynomial & crc_mask;
+    crc_init_value = config->init_value & crc_mask;
+    crc_reflected = config->reflect_input || config->reflect_output;
+
+    crc_begin();
+    return HAL_OK;
+}
+
+/**
+ * @brief Starts a new CRC: the unit is reloaded with the configured init value.
+ */
+void crc_begin(void) {
+    __HAL_CRC_DR_RESET(&hcrc);
+}
+
+/**
+ * @brief Adds a chunk of bytes to the CRC in progress.
+ * @param data Pointer to the bytes.
+ * @param length Number of bytes, any value.
+ * @return HAL_OK, or HAL_ERROR/HAL_TIMEOUT if the DMA transfer failed.
+ */
+HAL_StatusTypeDef crc_accumulate(const uint8_t* data, size_t length) {
+    HAL_StatusTypeDef status;
+    size_t chunk;
+
+    // The DMA counter is 16 bits, longer buffers take several transfers
+    while (length > 0) {
+        chunk = (length > CRC_DMA_MAX_LENGTH) ? CRC_DMA_MAX_LENGTH : length;
+        status = crc_accumulate_chunk(data, chunk);
+        if (status != HAL_OK) {
+            return status;
+        }
+        data += chunk;
+        length -= chunk;
+    }
+    return HAL_OK;
+}
+
+/**
+ * @brief Feeds at most CRC_DMA_MAX_LENGTH bytes, by DMA or by the CPU.
+ */
+static HAL_StatusTypeDef crc_accumulate_chunk(const uint8_t* data, size_t length) {
+    uint32_t start;
+
+    if (length < CRC_DMA_MIN_LENGTH || crc_dma_init() != HAL_OK) {
+        for (size_t i = 0; i < length; i++) {
+            *(__IO uint8_t*)&hcrc.Instance->DR = data[i];
+        }
+        return HAL_OK;
+    }
+
+    // Whole cache lines covering the buffer must reach memory before the DMA reads it
+    start = (uint32_t)data & ~31U;
+    SCB_CleanDCache_by_Addr((uint32_t*)start, CACHE_ROUND((uint32_t)data + length - start));
+
+    xSemaphoreTake(crc_dma_sem, 0);
+    if (HAL_DMA_Start_IT(&hdma_crc, (uint32_t)data, (uint32_t)&hcrc.Instance->DR, length) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    if (xSemaphoreTake(crc_dma_sem, CRC_DMA_TIMEOUT) != pdPASS) {
+        HAL_DMA_Abort(&hdma_crc);
+        return HAL_TIMEOUT;
+    }
+
+    return (hdma_crc.ErrorCode == HAL_DMA_ERROR_NONE) ? HAL_OK : HAL_ERROR;
+}
+
+/**
+ * @brief Returns the CRC of everything accumulated since crc_begin().
+ * * The unit keeps its state, so accumulation may continue afterwards.
+ */
+uint32_t crc_finish(void) {
+    return (hcrc.Instance->DR & crc_mask) ^ crc_final_xor;
+}
+
+/**
+ * @brief One-shot CRC of a single buffer.
+ * @param crc Receives the CRC, left untouched on failure.
+ * @return HAL_OK, or HAL_ERROR/HAL_TIMEOUT if the DMA transfer failed.
+ */
+HAL_StatusTypeDef crc_compute(const uint8_t* data, size_t length, uint32_t* crc) {
+    HAL_StatusTypeDef status;
+
+    crc_begin();
+    status = crc_accumulate(data, length);
+    if (status == HAL_OK) {
+        *crc = crc_finish();
+    }
+    return status;
+}
+
+/**
+ * @brief Starts a stream of repeated chunks: digests the chunk once and resets the unit.
+ * * Requires an unreflected CRC of at least 8 bits, where the register update is
+ * the plain polynomial arithmetic used here.
+ * @param stream Stream state to initialise.
+ * @param chunk The chunk every received chunk must match.
+ * @param length Chunk length in bytes.
+ * @return HAL_OK, HAL_ERROR for an unsupported configuration or a failed DMA transfer.
+ */
+HAL_StatusTypeDef crc_stream_begin(crc_stream_t* stream, const uint8_t* chunk, size_t length) {
+    uint32_t digest;
+
+    if (stream == NULL || crc_reflected || crc_width < 8U) {
+        return HAL_ERROR;
+    }
+
+    crc_begin();
+    if (crc_accumulate(chunk, length) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    digest = hcrc.Instance->DR & crc_mask;
+
+    // digest = init * x^(8n) + C, so C = digest - init * x^(8n) (subtraction is XOR)
+    stream->shift = crc_xpow(8U * length);
+    stream->chunk_term = digest ^ crc_mulmod(crc_init_value, stream->shift);
+    stream->expected = crc_init_value;
+    stream->chunks = 0;
+
+    crc_begin();
+    return HAL_OK;
+}
+
+/**
+ * @brief Chains one received chunk onto the stream CRC and checks it.
+ * @param stream Stream state from crc_stream_begin.
+ * @param chunk Received chunk, of the length given to crc_stream_begin.
+ * @param length Chunk length in bytes.
+ * @return 1 if the stream CRC matches the expectation after this chunk, 0 otherwise.
+ */
+uint8_t crc_stream_check(crc_stream_t* stream, const uint8_t* chunk, size_t length) {
+    if (crc_accumulate(chunk, length) != HAL_OK) {
+        return 0;
+    }
+
+    stream->expected = crc_mulmod(stream->expected, stream->shift) ^ stream->chunk_term;
+    stream->chunks++;
+
+    return (hcrc.Instance->DR & crc_mask) == stream->expected;
+}
+
+/**
+ * @brief Multiplies two polynomials modulo the active CRC polynomial.
+ */
+static uint32_t crc_mulmod(uint32_t a, uint32_t b) {
+    uint32_t top = 1U << (crc_width - 1U);
+    uint32_t result = 0;
+
+    for (int32_t bit = (int32_t)crc_width - 1; bit >= 0; bit--) {
+        // result = result * x mod P, then add a if this bit of b is set
+        if (result & top) {
+            result = ((result << 1) & crc_mask) ^ crc_polynomial;
+        }
+        else {
+            result = (result << 1) & crc_mask;
+        }
+        if ((b >> bit) & 1U) {
+            result ^= a;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Returns x^exponent modulo the active CRC polynomial, by repeated squaring.
+ */
+static uint32_t crc_xpow(uint32_t exponent) {
+    uint32_t result = 1U;
+    uint32_t base = 2U;     // x
+
+    while (exponent != 0) {
+        if (exponent & 1U) {
+            result = crc_mulmod(result, base);
+        }
+        base = crc_mulmod(base, base);
+        exponent >>= 1;
+    }
+    return result;
+}
+
+/**
+ * @brief One-time setup of the memory-to-memory DMA stream feeding CRC->DR.
+ * * In memory-to-memory mode the DMA reads from the "peripheral" port, so the
+ * source buffer increments and the destination (CRC->DR) stays fixed.
+ */
+static HAL_StatusTypeDef crc_dma_init(void) {
+    if (hdma_crc.Instance != NULL) {
+        return HAL_OK;
+    }
+
+    crc_dma_sem = xSemaphoreCreateBinaryStatic(&crc_dma_sem_buffer);
+
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    hdma_crc.Instance = DMA2_Stream7;
+    hdma_crc.Init.Channel = DMA_CHANNEL_0;
+    hdma_crc.Init.Direction = DMA_MEMORY_TO_MEMORY;
+    hdma_crc.Init.PeriphInc = DMA_PINC_ENABLE;
+    hdma_crc.Init.MemInc = DMA_MINC_DISABLE;
+    hdma_crc.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_crc.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_crc.Init.Mode = DMA_NORMAL;
+    hdma_crc.Init.Priority = DMA_PRIORITY_LOW;
+    hdma_crc.Init.FIFOMode = DMA_FIFOMODE_ENABLE;   // Required for memory-to-memory
+    hdma_crc.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
+    hdma_crc.Init.MemBurst = DMA_MBURST_SINGLE;
+    hdma_crc.Init.PeriphBurst = DMA_PBURST_SINGLE;
+    if (HAL_DMA_Init(&hdma_crc) != HAL_OK) {
+        hdma_crc.Instance = NULL;
+        return HAL_ERROR;
+    }
+    hdma_crc.XferCpltCallback = crc_dma_complete;
+    hdma_crc.XferErrorCallback = crc_dma_complete;
+
+    HAL_NVIC_SetPriority(DMA2_Stream7_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+
+    return HAL_OK;
+}
+
+/**
+ * @brief DMA completion (or error) callback, releases the waiting task.
+ */
+static void crc_dma_complete(DMA_HandleTypeDef* hdma) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    xSemaphoreGiveFromISR(crc_dma_sem, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
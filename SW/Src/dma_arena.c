@@ -0,0 +1,66 @@
+/**
+ * @file dma_arena.c
+ * @brief Shared arena of cache-line aligned DMA buffers, leased per test.
+ * * Design Decision:
+ * Tests used to keep their DMA buffers on the performing task's stack,
+ * unaligned and zeroed on every call, or in fixed per-file statics sized for
+ * the largest pattern. The arena replaces both: it lives in the .dma_buffers
+ * section (not zeroed at startup), every lease starts and ends on a 32-byte
+ * cache line, so cache maintenance on one buffer never touches another.
+ * Leases are stack-like: a test takes a mark, leases what it needs and
+ * releases back to the mark when it returns. Tests run one at a time on the
+ * performing task, so no locking is needed.
+ */
+
+#include "dma_arena.h"
+
+static uint8_t dma_arena[DMA_ARENA_SIZE] ALIGN_32 __attribute__((section(".dma_buffers")));
+static uint32_t dma_arena_used;
+
+/**
+ * @brief Returns the current fill level, to be handed back to dma_arena_release.
+ */
+dma_arena_mark_t dma_arena_mark(void) {
+    return dma_arena_used;
+}
+
+/**
+ * @brief Releases every lease taken since the mark.
+ */
+void dma_arena_release(dma_arena_mark_t mark) {
+    if (mark <= dma_arena_used) {
+        dma_arena_used = mark;
+    }
+}
+
+/**
+ * @brief Leases a cache-line aligned buffer. The content is undefined.
+ * @param size Requested size in bytes, rounded up to whole cache lines.
+ * @return Pointer to the buffer, or NULL if the arena is exhausted.
+ */
+uint8_t* dma_arena_lease(size_t size) {
+    uint32_t rounded = CACHE_ROUND(size);
+    uint8_t* buffer;
+
+    if (rounded == 0 || rounded > DMA_ARENA_SIZE - dma_arena_used) {
+        return NULL;
+    }
+
+    buffer = &dma_arena[dma_arena_used];
+    dma_arena_used += rounded;
+    return buffer;
+}
+
+/**
+ * @brief Writes CPU-side data of a leased buffer to RAM before a DMA reads it.
+ */
+void dma_buffer_clean(const void* buffer, size_t size) {
+    SCB_CleanDCache_by_Addr((uint32_t*)buffer, CACHE_ROUND(size));
+}
+
+/**
+ * @brief Drops cached lines of a leased buffer so the CPU reads what a DMA wrote.
+ */
+void dma_buffer_invalidate(void* buffer, size_t size) {
+    SCB_InvalidateDCache_by_Addr((uint32_t*)buffer, CACHE_ROUND(size));
+}
@@ -12,6 +12,8 @@
 #define I2C_RECEIVER    (&hi2c1)   // Slave instance
 #define I2C_SLAVE_ADDR  (120 << 1) // 7-bit address left-shifted for HAL compatibility
 
+static Result i2c_loopback(test_command_t* command, uint8_t* tx_buffer, uint8_t* rx_buffer, uint8_t* echo_buffer);
+
 /**
  * @brief Performs a hardware verification test on the I2C peripherals.
  * * This test transmits a bit pattern from the Master to the Slave using DMA,
@@ -21,21 +23,65 @@
  */
 Result i2c_testing(test_command_t* command) {
 
-    // Local buffers for transfer validation
-    uint8_t tx_buffer[MAX_BIT_PATTERN_LENGTH] = {0};
-    uint8_t rx_buffer[MAX_BIT_PATTERN_LENGTH] = {0};
-    uint8_t echo_buffer[MAX_BIT_PATTERN_LENGTH] = {0};
-    HAL_StatusTypeDef status;
+    dma_arena_mark_t mark;
+    uint8_t* tx_buffer;
+    uint8_t* rx_buffer;
+    uint8_t* echo_buffer;
+    Result result;
 
     if (command == NULL) {
         return TEST_ERR;
     }
 
+    // DMA-safe buffers leased from the shared arena for the duration of the test
+    mark = dma_arena_mark();
+    tx_buffer = dma_arena_lease(command->bit_pattern_length);
+    rx_buffer = dma_arena_lease(command->bit_pattern_length);
+    echo_buffer = dma_arena_lease(command->bit_pattern_length);
+
+    if (tx_buffer == NULL || rx_buffer == NULL || echo_buffer == NULL) {
+        result = TEST_FAIL;
+    }
+    else {
+        result = i2c_loopback(command, tx_buffer, rx_buffer, echo_buffer);
+    }
+
+    dma_arena_release(mark);
+    return result;
+}
+
+/**
+ * @brief Runs the loopback iterations on leased buffers.
+ * @param command Pointer to the test_command_t structure.
+ * @param tx_buffer Pattern sent by the master.
+ * @param rx_buffer Echo received back by the master.
+ * @param echo_buffer Pattern received by the slave and echoed.
+ */
+static Result i2c_loopback(test_command_t* command, uint8_t* tx_buffer, uint8_t* rx_buffer, uint8_t* echo_buffer) {
+
+    HAL_StatusTypeDef status;
+    crc_stream_t stream;
+
     // Initialize the transmit buffer with the command pattern
     memcpy(tx_buffer, command->bit_pattern, command->bit_pattern_length);
+    dma_buffer_clean(tx_buffer, command->bit_pattern_length);
+
+    // Large patterns: digest TX once, then only the received data is CRC'd per iteration
+    if (command->bit_pattern_length > 100 &&
+        crc_stream_begin(&stream, tx_buffer, command->bit_pattern_length) != HAL_OK) {
+        return TEST_FAIL;
+    }
 
     for (uint8_t i = 0; i < command->iterations; i++) {
+        if (test_checkpoint(i)) {
+            return TEST_ABORTED;
+        }
         memset(rx_buffer, 0, command->bit_pattern_length);
+        dma_buffer_invalidate(echo_buffer, command->bit_pattern_length);
+
+        // Drain stale completions, an aborted test may have left one
+        xSemaphoreTake(I2cTxHandle, 0);
+        xSemaphoreTake(I2cRxHandle, 0);
 
         // --- 1. Prepare Slave for Reception (DMA Mode) ---
         status = HAL_I2C_Slave_Receive_DMA(I2C_RECEIVER, echo_buffer, command->bit_pattern_length);
@@ -52,7 +98,7 @@ Result i2c_testing(test_command_t* command) {
         }
 
         // Wait for Master Transmission to complete
-        if (xSemaphoreTake(I2cTxHandle, TIMEOUT) != pdPASS) {
+        if (test_wait(I2cTxHandle, TIMEOUT) != pdPASS) {
             i2c_reset(I2C_SENDER);
             i2c_reset(I2C_RECEIVER);
             return TEST_FAIL;
@@ -61,6 +107,8 @@ Result i2c_testing(test_command_t* command) {
         // Small delay to ensure Slave DMA processing is finalized
         HAL_Delay(1);
 
+        dma_buffer_invalidate(echo_buffer, command->bit_pattern_length);
+
         // --- 3. Echo Phase: Slave Transmits back to Master (Interrupt Mode) ---
         status = HAL_I2C_Slave_Transmit_IT(I2C_RECEIVER, echo_buffer, command->bit_pattern_length);
         if (status != HAL_OK) {
@@ -76,7 +124,7 @@ Result i2c_testing(test_command_t* command) {
         }
 
         // Wait for the Echo reception to complete
-        if (xSemaphoreTake(I2cRxHandle, TIMEOUT) != pdPASS) {
+        if (test_wait(I2cRxHandle, TIMEOUT) != pdPASS) {
             i2c_reset(I2C_SENDER);
             i2c_reset(I2C_RECEIVER);
             return TEST_FAIL;
@@ -84,10 +132,8 @@ Result i2c_testing(test_command_t* command) {
 
         // --- 4. Data Integrity Validation ---
         if (command->bit_pattern_length > 100) {
-            // CRC check for large data blocks (>100 bytes) per project spec
-            uint32_t sent_crc = calculate_crc(tx_buffer, command->bit_pattern_length);
-            uint32_t received_crc = calculate_crc(rx_buffer, command->bit_pattern_length);
-            if (sent_crc != received_crc) {
+            // Running CRC over everything received, checked against the TX digest chain
+            if (!crc_stream_check(&stream, rx_buffer, command->bit_pattern_length)) {
                 return TEST_FAIL;
             }
         } else {
@@ -0,0 +1,529 @@
+/**
+ * @file iperf_server.c
+ * @brief iperf2-compatible throughput server on IPERF_PORT, TCP and UDP.
+ */
+
+#include "iperf_server.h"
+
+#include <string.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/tcp.h"
+#include "lwip/udp.h"
+#include "lwip/timeouts.h"
+
+// Defined either way, IPERF_STATS reports zeros when the server is left out
+iperf_stats_t iperf_stats;
+
+#if IPERF_SERVER
+
+#define IPERF_HEADER_VERSION1   0x80000000UL    // client_hdr is valid
+#define IPERF_RUN_NOW           0x00000001UL    // -d: source runs alongside the sink
+#define IPERF_TCP_POLL          2               // tcp_tmr ticks (1 s), source time limit check
+#define IPERF_UDP_IDLE_MS       2000            // A UDP run without datagrams this long is over
+#define IPERF_PATTERN_LENGTH    TCP_MSS
+
+/* iperf2's settings header, at the start of a TCP stream and after the UDP header */
+typedef struct iperf_client_hdr_t {
+    int32_t flags;
+    int32_t num_threads;
+    int32_t port;
+    int32_t buffer_len;
+    int32_t win_band;
+    int32_t amount;                 // Bytes, or when negative the time in 10 ms units
+} iperf_client_hdr_t;
+
+/* Starts every UDP datagram */
+typedef struct iperf_udp_hdr_t {
+    int32_t id;                     // Negative on the final datagram
+    uint32_t tv_sec;
+    uint32_t tv_usec;
+} iperf_udp_hdr_t;
+
+/* The UDP server's report, sent after iperf_udp_hdr_t */
+typedef struct iperf_server_hdr_t {
+    int32_t flags;
+    int32_t total_len1;             // Bytes, high word
+    int32_t total_len2;             // Bytes, low word
+    int32_t stop_sec;
+    int32_t stop_usec;
+    int32_t error_cnt;
+    int32_t outorder_cnt;
+    int32_t datagrams;
+    int32_t jitter1;                // Seconds
+    int32_t jitter2;                // Microseconds
+} iperf_server_hdr_t;
+
+typedef struct iperf_run_t {
+    uint8_t mode;                   // IPERF_* mode, 0 when the slot is free
+    uint64_t bytes;
+    uint32_t start_ms;
+    uint64_t start_busy;            // sched_busy_cycles_get() at the start
+} iperf_run_t;
+
+typedef struct iperf_tcp_t {
+    iperf_run_t run;
+    struct tcp_pcb* pcb;
+    iperf_client_hdr_t settings;    // Sink: the client's header, host order once complete
+    uint8_t settings_valid;
+    uint8_t source_pending;         // -r: connect back once the sink closes
+    ip_addr_t remote;               // Sink: the client; source: where to connect
+    int32_t amount;                 // Source: bytes, or negative 10 ms units
+    uint64_t queued;                // Source: bytes written, run.bytes counts those acknowledged
+} iperf_tcp_t;
+
+typedef struct iperf_udp_t {
+    iperf_run_t run;
+    ip_addr_t remote;
+    u16_t port;
+    int32_t next_id;                // Highest ID seen plus one
+    uint32_t datagrams;
+    uint32_t lost;
+    uint32_t out_of_order;
+    uint32_t last_rx_ms;
+    uint32_t last_arrival_cycles;   // DWT stamp of the previous datagram
+    uint32_t last_sent_us;          // Its sender timestamp, microseconds
+    uint32_t jitter_us16;           // Jitter in 1/16 us, the RFC 1889 filter
+    iperf_server_hdr_t report;      // Last report, resent when the client repeats its final datagram
+    uint8_t report_valid;
+} iperf_udp_t;
+
+static iperf_tcp_t sink;
+static iperf_tcp_t source;
+static iperf_udp_t udp;
+static uint8_t pattern[IPERF_PATTERN_LENGTH];
+
+static err_t iperf_tcp_accept(void* arg, struct tcp_pcb* pcb, err_t err);
+static err_t iperf_tcp_recv(void* arg, struct tcp_pcb* pcb, struct pbuf* p, err_t err);
+static void iperf_tcp_error(void* arg, err_t err);
+static err_t iperf_source_connected(void* arg, struct tcp_pcb* pcb, err_t err);
+static err_t iperf_source_send(void* arg, struct tcp_pcb* pcb, u16_t len);
+static err_t iperf_source_poll(void* arg, struct tcp_pcb* pcb);
+static void iperf_udp_recv(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port);
+static void iperf_udp_timeout(void* arg);
+
+static uint32_t iperf_now_ms(void) {
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void iperf_run_start(iperf_run_t* run, uint8_t mode) {
+    run->mode = mode;
+    run->bytes = 0;
+    run->start_ms = iperf_now_ms();
+    run->start_busy = sched_busy_cycles_get();
+    iperf_stats.active++;
+}
+
+/**
+ * @brief Publishes a finished run to iperf_stats and frees its slot.
+ */
+static void iperf_run_end(iperf_run_t* run) {
+    uint32_t duration = iperf_now_ms() - run->start_ms;
+    uint64_t busy = sched_busy_cycles_get() - run->start_busy;
+    uint64_t available;
+
+    if (run->mode == 0) {
+        return;
+    }
+    if (duration == 0) {
+        duration = 1;
+    }
+    available = (uint64_t)duration * (SystemCoreClock / 1000U);
+
+    iperf_stats.mode = run->mode;
+    iperf_stats.bytes = (uint32_t)run->bytes;
+    iperf_stats.duration_ms = duration;
+    iperf_stats.kbit_per_s = (uint32_t)(run->bytes * 8U / duration);    // Bits per ms
+    iperf_stats.cpu_load_permille = (busy >= available) ? 1000U : (uint32_t)(busy * 1000U / available);
+    iperf_stats.runs++;
+    iperf_stats.active--;
+    run->mode = 0;
+}
+
+/**
+ * @brief Opens the TCP listener and binds the UDP port.
+ */
+void iperf_server_init(void) {
+    struct tcp_pcb* listener = tcp_new();
+    struct udp_pcb* udp_pcb = udp_new();
+    uint32_t i;
+
+    // The same digits iperf itself sends
+    for (i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = (uint8_t)('0' + i % 10U);
+    }
+
+    if (listener != NULL) {
+        if (tcp_bind(listener, IP_ADDR_ANY, IPERF_PORT) != ERR_OK) {
+            tcp_close(listener);
+        } else {
+            listener = tcp_listen_with_backlog(listener, 1);
+            if (listener != NULL) {
+                tcp_accept(listener, iperf_tcp_accept);
+            }
+        }
+    }
+
+    if (udp_pcb != NULL) {
+        if (udp_bind(udp_pcb, IP_ADDR_ANY, IPERF_PORT) != ERR_OK) {
+            udp_remove(udp_pcb);
+        } else {
+            udp_recv(udp_pcb, iperf_udp_recv, NULL);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------- TCP --- */
+
+static void iperf_tcp_detach(iperf_tcp_t* conn) {
+    if (conn->pcb != NULL) {
+        tcp_arg(conn->pcb, NULL);
+        tcp_recv(conn->pcb, NULL);
+        tcp_sent(conn->pcb, NULL);
+        tcp_poll(conn->pcb, NULL, 0);
+        tcp_err(conn->pcb, NULL);
+        conn->pcb = NULL;
+    }
+    iperf_run_end(&conn->run);
+}
+
+/**
+ * @brief Closes a connection and ends its run.
+ * @return ERR_ABRT when the pcb had to be aborted, to be passed up from a callback.
+ */
+static err_t iperf_tcp_close(iperf_tcp_t* conn) {
+    struct tcp_pcb* pcb = conn->pcb;
+    err_t err = ERR_OK;
+
+    iperf_tcp_detach(conn);
+    if (pcb != NULL && tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+        err = ERR_ABRT;
+    }
+    return err;
+}
+
+/**
+ * @brief Connects back to the client to run the source half of -r or -d.
+ */
+static void iperf_source_start(void) {
+    struct tcp_pcb* pcb;
+
+    if (source.run.mode != 0 || source.pcb != NULL) {
+        return;
+    }
+    pcb = tcp_new();
+    if (pcb == NULL) {
+        return;
+    }
+    source.pcb = pcb;
+    tcp_arg(pcb, &source);
+    tcp_err(pcb, iperf_tcp_error);
+    if (tcp_connect(pcb, &source.remote, (u16_t)sink.settings.port, iperf_source_connected) != ERR_OK) {
+        source.pcb = NULL;
+        tcp_abort(pcb);
+    }
+}
+
+static err_t iperf_tcp_accept(void* arg, struct tcp_pcb* pcb, err_t err) {
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+    // One sink at a time, a second client is refused while a run is on
+    if (sink.pcb != NULL) {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+
+    memset(&sink.settings, 0, sizeof(sink.settings));
+    sink.settings_valid = 0;
+    sink.source_pending = 0;
+    sink.pcb = pcb;
+    ip_addr_copy(sink.remote, pcb->remote_ip);
+    iperf_run_start(&sink.run, IPERF_TCP_SINK);
+
+    tcp_arg(pcb, &sink);
+    tcp_recv(pcb, iperf_tcp_recv);
+    tcp_err(pcb, iperf_tcp_error);
+    return ERR_OK;
+}
+
+/**
+ * @brief Reads the client's settings header from the first bytes of the stream.
+ */
+static void iperf_tcp_settings(struct pbuf* p) {
+    uint32_t have = (uint32_t)sink.run.bytes;
+    int32_t* field = (int32_t*)&sink.settings;
+    uint32_t i;
+
+    if (have >= sizeof(sink.settings)) {
+        return;
+    }
+    pbuf_copy_partial(p, (uint8_t*)&sink.settings + have, (u16_t)(sizeof(sink.settings) - have), 0);
+    if (have + p->tot_len < sizeof(sink.settings)) {
+        return;
+    }
+
+    for (i = 0; i < sizeof(sink.settings) / sizeof(int32_t); i++) {
+        field[i] = (int32_t)lwip_ntohl((uint32_t)field[i]);
+    }
+    // Without the version flag the stream is plain data, the client wants no source
+    if (((uint32_t)sink.settings.flags & IPERF_HEADER_VERSION1) == 0) {
+        return;
+    }
+    sink.settings_valid = 1;
+    ip_addr_copy(source.remote, sink.remote);
+    source.amount = sink.settings.amount;
+    if ((uint32_t)sink.settings.flags & IPERF_RUN_NOW) {
+        iperf_source_start();
+    } else {
+        sink.source_pending = 1;
+    }
+}
+
+static err_t iperf_tcp_recv(void* arg, struct tcp_pcb* pcb, struct pbuf* p, err_t err) {
+    iperf_tcp_t* conn = (iperf_tcp_t*)arg;
+    uint8_t start_source;
+    err_t result;
+
+    if (conn == NULL) {
+        if (p != NULL) {
+            pbuf_free(p);
+        }
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+
+    if (p == NULL || err != ERR_OK) {
+        // The client finished sending: the run is over, then -r turns around
+        start_source = conn->source_pending;
+        if (p != NULL) {
+            pbuf_free(p);
+        }
+        result = iperf_tcp_close(conn);
+        if (start_source) {
+            iperf_source_start();
+        }
+        return result;
+    }
+
+    // The source counts what the client acknowledges, not what it sends back
+    if (conn == &sink) {
+        iperf_tcp_settings(p);
+        conn->run.bytes += p->tot_len;
+    }
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+    return ERR_OK;
+}
+
+static void iperf_tcp_error(void* arg, err_t err) {
+    iperf_tcp_t* conn = (iperf_tcp_t*)arg;
+
+    // The pcb is already freed
+    if (conn != NULL) {
+        conn->pcb = NULL;
+        iperf_run_end(&conn->run);
+    }
+}
+
+/**
+ * @brief Tells whether the source has written all it will write.
+ */
+static uint8_t iperf_source_done(void) {
+    if (source.amount >= 0) {
+        return source.queued >= (uint32_t)source.amount;
+    }
+    return iperf_now_ms() - source.run.start_ms >= (uint32_t)(-source.amount) * 10U;
+}
+
+static err_t iperf_source_connected(void* arg, struct tcp_pcb* pcb, err_t err) {
+    if (err != ERR_OK) {
+        return iperf_tcp_close(&source);
+    }
+    iperf_run_start(&source.run, IPERF_TCP_SOURCE);
+    source.queued = 0;
+    tcp_recv(pcb, iperf_tcp_recv);
+    tcp_sent(pcb, iperf_source_send);
+    tcp_poll(pcb, iperf_source_poll, IPERF_TCP_POLL);
+    return iperf_source_send(arg, pcb, 0);
+}
+
+/**
+ * @brief Fills the send buffer with the pattern until the run is done.
+ * @details Also the tcp_sent callback: the run counts the acknowledged bytes
+ * and ends once everything written has been acknowledged.
+ */
+static err_t iperf_source_send(void* arg, struct tcp_pcb* pcb, u16_t len) {
+    u16_t space;
+    err_t err;
+
+    source.run.bytes += len;
+
+    while (!iperf_source_done()) {
+        space = tcp_sndbuf(pcb);
+        if (space > sizeof(pattern)) {
+            space = sizeof(pattern);
+        }
+        if (source.amount >= 0 && space > (uint32_t)source.amount - source.queued) {
+            space = (u16_t)((uint32_t)source.amount - source.queued);
+        }
+        if (space == 0 || tcp_sndqueuelen(pcb) >= TCP_SND_QUEUELEN) {
+            break;
+        }
+        // No copy: the segments point into the pattern
+        err = tcp_write(pcb, pattern, space, TCP_WRITE_FLAG_MORE);
+        if (err != ERR_OK) {
+            break;
+        }
+        source.queued += space;
+    }
+
+    if (iperf_source_done() && source.run.bytes >= source.queued) {
+        return iperf_tcp_close(&source);
+    }
+    tcp_output(pcb);
+    return ERR_OK;
+}
+
+static err_t iperf_source_poll(void* arg, struct tcp_pcb* pcb) {
+    // Ends a timed run that stalled, otherwise keeps the pipe full
+    return iperf_source_send(arg, pcb, 0);
+}
+
+/* ---------------------------------------------------------------- UDP --- */
+
+/**
+ * @brief Ends the UDP run and fills in the report the client prints.
+ */
+static void iperf_udp_end(void) {
+    uint32_t duration = iperf_now_ms() - udp.run.start_ms;
+    uint32_t jitter = udp.jitter_us16 / 16U;
+    iperf_server_hdr_t* r = &udp.report;
+
+    r->flags = (int32_t)lwip_htonl(IPERF_HEADER_VERSION1);
+    r->total_len1 = (int32_t)lwip_htonl((uint32_t)(udp.run.bytes >> 32));
+    r->total_len2 = (int32_t)lwip_htonl((uint32_t)udp.run.bytes);
+    r->stop_sec = (int32_t)lwip_htonl(duration / 1000U);
+    r->stop_usec = (int32_t)lwip_htonl((duration % 1000U) * 1000U);
+    r->error_cnt = (int32_t)lwip_htonl(udp.lost);
+    r->outorder_cnt = (int32_t)lwip_htonl(udp.out_of_order);
+    r->datagrams = (int32_t)lwip_htonl((uint32_t)udp.next_id);
+    r->jitter1 = (int32_t)lwip_htonl(jitter / 1000000U);
+    r->jitter2 = (int32_t)lwip_htonl(jitter % 1000000U);
+    udp.report_valid = 1;
+
+    iperf_stats.datagrams = udp.datagrams;
+    iperf_stats.lost = udp.lost;
+    iperf_stats.out_of_order = udp.out_of_order;
+    iperf_stats.jitter_us = jitter;
+    iperf_run_end(&udp.run);
+    sched_stay_awake_net = 0;
+    sys_untimeout(iperf_udp_timeout, NULL);
+}
+
+static void iperf_udp_timeout(void* arg) {
+    if (udp.run.mode == 0) {
+        return;
+    }
+    if (iperf_now_ms() - udp.last_rx_ms >= IPERF_UDP_IDLE_MS) {
+        // The client's final datagrams were all lost
+        iperf_udp_end();
+        return;
+    }
+    sys_timeout(IPERF_UDP_IDLE_MS, iperf_udp_timeout, NULL);
+}
+
+static void iperf_udp_report(struct udp_pcb* pcb, const iperf_udp_hdr_t* hdr, const ip_addr_t* addr, u16_t port) {
+    struct pbuf* reply = pbuf_alloc(PBUF_TRANSPORT, sizeof(*hdr) + sizeof(udp.report), PBUF_RAM);
+
+    if (reply == NULL) {
+        return;
+    }
+    memcpy(reply->payload, hdr, sizeof(*hdr));
+    memcpy((uint8_t*)reply->payload + sizeof(*hdr), &udp.report, sizeof(udp.report));
+    udp_sendto(pcb, reply, addr, port);
+    pbuf_free(reply);
+}
+
+/**
+ * @brief Updates the RFC 1889 jitter filter with one more datagram.
+ */
+static void iperf_udp_jitter(const iperf_udp_hdr_t* hdr, uint32_t arrival_cycles) {
+    uint32_t sent_us = lwip_ntohl(hdr->tv_sec) * 1000000U + lwip_ntohl(hdr->tv_usec);
+    uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+    int32_t d;
+
+    if (udp.datagrams > 1) {
+        // Change in transit time: arrival spacing minus send spacing
+        d = (int32_t)((arrival_cycles - udp.last_arrival_cycles) / cycles_per_us)
+            - (int32_t)(sent_us - udp.last_sent_us);
+        if (d < 0) {
+            d = -d;
+        }
+        udp.jitter_us16 += (uint32_t)d - (udp.jitter_us16 + 8U) / 16U;
+    }
+    udp.last_arrival_cycles = arrival_cycles;
+    udp.last_sent_us = sent_us;
+}
+
+static void iperf_udp_recv(void* arg, struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port) {
+    uint32_t arrival_cycles = DWT->CYCCNT;
+    iperf_udp_hdr_t hdr;
+    int32_t id;
+
+    if (p->tot_len < sizeof(hdr)) {
+        pbuf_free(p);
+        return;
+    }
+    pbuf_copy_partial(p, &hdr, sizeof(hdr), 0);
+    id = (int32_t)lwip_ntohl((uint32_t)hdr.id);
+
+    if (id < 0) {
+        // The final datagram, repeated by the client until the report arrives
+        if (udp.run.mode != 0 && udp.port == port && ip_addr_cmp(&udp.remote, addr)) {
+            udp.run.bytes += p->tot_len;
+            iperf_udp_end();
+        }
+        if (udp.report_valid) {
+            iperf_udp_report(pcb, &hdr, addr, port);
+        }
+        pbuf_free(p);
+        return;
+    }
+
+    if (udp.run.mode == 0 || udp.port != port || !ip_addr_cmp(&udp.remote, addr)) {
+        // A new client takes over, a stale run is dropped without a report
+        if (udp.run.mode != 0) {
+            iperf_run_end(&udp.run);
+            sys_untimeout(iperf_udp_timeout, NULL);
+        }
+        memset(&udp, 0, sizeof(udp));
+        ip_addr_copy(udp.remote, *addr);
+        udp.port = port;
+        iperf_run_start(&udp.run, IPERF_UDP_SINK);
+        // Interarrival times come from the DWT counter, which stops in sleep
+        sched_stay_awake_net = 1;
+        sys_timeout(IPERF_UDP_IDLE_MS, iperf_udp_timeout, NULL);
+    }
+
+    udp.last_rx_ms = iperf_now_ms();
+    udp.run.bytes += p->tot_len;
+    udp.datagrams++;
+    if (id >= udp.next_id) {
+        udp.lost += (uint32_t)(id - udp.next_id);
+        udp.next_id = id + 1;
+    } else {
+        // Counted as lost when the gap was seen, it was only late
+        udp.out_of_order++;
+        if (udp.lost > 0) {
+            udp.lost--;
+        }
+    }
+    iperf_udp_jitter(&hdr, arrival_cycles);
+    pbuf_free(p);
+}
+
+#endif /* IPERF_SERVER */
@@ -0,0 +1,142 @@
+/**
+ * @file mqtt_telemetry.c
+ * @brief Publishes batched test results and NET_METRICS to an MQTT broker.
+ */
+
+#include "mqtt_telemetry.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "main.h"
+#include "lwip/timeouts.h"
+#include "lwip/apps/mqtt.h"
+#include "lwip/apps/mqtt_priv.h"
+
+// Defined either way, NET_STATS reports zeros when telemetry is left out
+mqtt_telemetry_stats_t mqtt_telemetry_stats;
+
+#if MQTT_TELEMETRY
+
+#define MQTT_TOPIC_LENGTH   48
+
+static mqtt_client_t client;        // Static, so the lwIP heap is not charged
+static struct mqtt_connect_client_info_t client_info;
+static char board_id[25];          // The chip's unique ID in hex
+static char client_id[32];
+static char results_topic[MQTT_TOPIC_LENGTH];
+static char metrics_topic[MQTT_TOPIC_LENGTH];
+static ip_addr_t broker;
+
+static uint8_t batch[MQTT_BATCH_MAX];
+static uint16_t batch_length;       // Header included, 0 when empty
+static uint16_t batch_drops;        // Results lost since the last batch went out
+static void (*metrics_source)(net_metrics_t* metrics);
+static net_metrics_t metrics;
+static uint32_t ticks;
+
+static void mqtt_telemetry_tick(void* arg);
+
+static void mqtt_telemetry_connection(mqtt_client_t* c, void* arg, mqtt_connection_status_t status) {
+    if (status == MQTT_CONNECT_ACCEPTED) {
+        mqtt_telemetry_stats.connects++;
+    }
+    // Anything else: the client has closed the connection, the tick reconnects
+}
+
+static int mqtt_telemetry_publish(const char* topic, const void* payload, uint16_t length) {
+    if (!mqtt_client_is_connected(&client)
+        || mqtt_publish(&client, topic, payload, length, MQTT_TELEMETRY_QOS, 0, NULL, NULL) != ERR_OK) {
+        mqtt_telemetry_stats.publish_errors++;
+        return -1;
+    }
+    mqtt_telemetry_stats.published++;
+    return 0;
+}
+
+/**
+ * @brief Connects to the broker and starts the publish timer.
+ * @param get_metrics Fills the NET_METRICS snapshot published periodically.
+ */
+void mqtt_telemetry_init(void (*get_metrics)(net_metrics_t* metrics)) {
+    // The unique ID tells the boards of a fleet apart, in the client ID and the topics
+    snprintf(board_id, sizeof(board_id), "%08lx%08lx%08lx",
+             (unsigned long)HAL_GetUIDw2(), (unsigned long)HAL_GetUIDw1(), (unsigned long)HAL_GetUIDw0());
+    snprintf(client_id, sizeof(client_id), MQTT_TOPIC_PREFIX "-%s", board_id);
+    snprintf(results_topic, sizeof(results_topic), MQTT_TOPIC_PREFIX "/%s/results", board_id);
+    snprintf(metrics_topic, sizeof(metrics_topic), MQTT_TOPIC_PREFIX "/%s/metrics", board_id);
+    client_info.client_id = client_id;
+    client_info.keep_alive = MQTT_KEEP_ALIVE_S;
+
+    metrics_source = get_metrics;
+    if (!ipaddr_aton(MQTT_BROKER_ADDR, &broker)) {
+        return;
+    }
+    mqtt_client_connect(&client, &broker, MQTT_BROKER_PORT, mqtt_telemetry_connection, NULL, &client_info);
+    sys_timeout(MQTT_BATCH_MS, mqtt_telemetry_tick, NULL);
+}
+
+/**
+ * @brief Appends a result to the current batch, never waits.
+ * @details Called from send_report with the core lock held.
+ */
+void mqtt_telemetry_result(result_pro_t result, const test_report_t* report) {
+    mqtt_result_record_t record;
+    uint16_t report_length = (report != NULL) ? report->length : 0;
+
+    if (batch_length == 0) {
+        batch_length = sizeof(mqtt_batch_header_t);
+    }
+    if (batch_length + sizeof(record) + report_length > sizeof(batch)) {
+        mqtt_telemetry_stats.result_drops++;
+        if (batch_drops < UINT16_MAX) {
+            batch_drops++;
+        }
+        return;
+    }
+
+    record.test_id = result.test_id;
+    record.test_result = (int16_t)result.test_result;
+    record.report_length = (uint8_t)report_length;
+    memcpy(&batch[batch_length], &record, sizeof(record));
+    batch_length += sizeof(record);
+    if (report_length > 0) {
+        memcpy(&batch[batch_length], report->data, report_length);
+        batch_length += report_length;
+    }
+    ((mqtt_batch_header_t*)batch)->records++;
+}
+
+/**
+ * @brief Publishes the batch and the metrics when due, reconnects when down.
+ */
+static void mqtt_telemetry_tick(void* arg) {
+    mqtt_batch_header_t* header = (mqtt_batch_header_t*)batch;
+
+    ticks++;
+    if (!mqtt_client_is_connected(&client)) {
+        if (ticks % (MQTT_RECONNECT_MS / MQTT_BATCH_MS) == 0) {
+            // ERR_ISCONN while the previous attempt is still in progress
+            mqtt_client_connect(&client, &broker, MQTT_BROKER_PORT, mqtt_telemetry_connection, NULL,
+                                &client_info);
+        }
+    } else {
+        if (batch_length > 0) {
+            header->version = MQTT_BATCH_VERSION;
+            header->dropped = batch_drops;
+            // Refused batches stay and go out on a later tick
+            if (mqtt_telemetry_publish(results_topic, batch, batch_length) == 0) {
+                batch_length = 0;
+                batch_drops = 0;
+                memset(header, 0, sizeof(*header));
+            }
+        }
+        if (metrics_source != NULL && ticks % (MQTT_METRICS_MS / MQTT_BATCH_MS) == 0) {
+            metrics_source(&metrics);
+            mqtt_telemetry_publish(metrics_topic, &metrics, sizeof(metrics));
+        }
+    }
+    sys_timeout(MQTT_BATCH_MS, mqtt_telemetry_tick, NULL);
+}
+
+#endif /* MQTT_TELEMETRY */
@@ -0,0 +1,172 @@
+/**
+ * @file result_cache.c
+ * @brief Bounded replay cache of UDP results, keyed by client and test ID.
+ */
+
+#include "result_cache.h"
+
+#include <string.h>
+
+#include "lwip/sys.h"
+
+#define NO_ENTRY    0xFF
+
+typedef struct result_cache_entry_t {
+    ip_addr_t addr;                 // Client address and port, with test_id the key
+    u16_t port;
+    uint8_t state;                  // RESULT_CACHE_MISS when the entry is free
+    uint8_t next;                   // Next entry in the same bucket, NO_ENTRY ends the chain
+    uint32_t test_id;
+    uint32_t finished;              // sys_now() at completion, the oldest is evicted first
+    result_pro_t result;
+    test_report_t report;
+} result_cache_entry_t;
+
+result_cache_stats_t result_cache_stats;
+
+static result_cache_entry_t entries[RESULT_CACHE_ENTRIES];
+static uint8_t buckets[RESULT_CACHE_BUCKETS];
+static uint8_t initialised;
+
+static uint32_t result_cache_hash(const ip_addr_t* addr, u16_t port, uint32_t test_id) {
+    uint32_t h = ip4_addr_get_u32(ip_2_ip4(addr)) ^ ((uint32_t)port << 16) ^ test_id;
+
+    // Multiplicative hash, the well-mixed upper half selects the bucket
+    h *= 2654435761U;
+    return (h >> 16) & (RESULT_CACHE_BUCKETS - 1);
+}
+
+static void result_cache_init(void) {
+    memset(buckets, NO_ENTRY, sizeof(buckets));
+    initialised = 1;
+}
+
+static uint8_t result_cache_find(const ip_addr_t* addr, u16_t port, uint32_t test_id) {
+    uint8_t i;
+
+    for (i = buckets[result_cache_hash(addr, port, test_id)]; i != NO_ENTRY; i = entries[i].next) {
+        if (entries[i].test_id == test_id && entries[i].port == port && ip_addr_cmp(&entries[i].addr, addr)) {
+            return i;
+        }
+    }
+    return NO_ENTRY;
+}
+
+static void result_cache_unlink(uint8_t index) {
+    result_cache_entry_t* e = &entries[index];
+    uint8_t* link = &buckets[result_cache_hash(&e->addr, e->port, e->test_id)];
+
+    while (*link != index) {
+        link = &entries[*link].next;
+    }
+    *link = e->next;
+    e->state = RESULT_CACHE_MISS;
+}
+
+/**
+ * @brief Picks a free entry, evicting the oldest finished result if needed.
+ * @return The entry index, or NO_ENTRY when every entry is in flight.
+ */
+static uint8_t result_cache_slot(void) {
+    uint8_t oldest = NO_ENTRY;
+    uint8_t i;
+
+    for (i = 0; i < RESULT_CACHE_ENTRIES; i++) {
+        if (entries[i].state == RESULT_CACHE_MISS) {
+            return i;
+        }
+        if (entries[i].state == RESULT_CACHE_DONE
+            && (oldest == NO_ENTRY || (int32_t)(entries[i].finished - entries[oldest].finished) < 0)) {
+            oldest = i;
+        }
+    }
+    if (oldest != NO_ENTRY) {
+        result_cache_unlink(oldest);
+        result_cache_stats.evictions++;
+    }
+    return oldest;
+}
+
+/**
+ * @brief Looks a command up and starts tracking it if it is new.
+ * @param result Set to the cached result when RESULT_CACHE_DONE is returned.
+ * @param report Set to the cached report when RESULT_CACHE_DONE is returned.
+ * @return What the caller should do: run it (MISS), drop it (IN_FLIGHT) or
+ * replay the cached result (DONE).
+ */
+result_cache_state_t result_cache_claim(const ip_addr_t* addr, u16_t port, uint32_t test_id,
+                                        const result_pro_t** result, const test_report_t** report) {
+    uint8_t i;
+    uint32_t h;
+
+    if (!initialised) {
+        result_cache_init();
+    }
+    // Test ID 0 is rejected by the executor, such commands are not tracked
+    if (test_id == 0) {
+        return RESULT_CACHE_MISS;
+    }
+
+    i = result_cache_find(addr, port, test_id);
+    // Too old to be a resend of the same request, the client reused its test ID
+    if (i != NO_ENTRY && entries[i].state == RESULT_CACHE_DONE
+        && sys_now() - entries[i].finished > RESULT_CACHE_MAX_AGE_MS) {
+        result_cache_unlink(i);
+        result_cache_stats.expired++;
+        i = NO_ENTRY;
+    }
+    if (i != NO_ENTRY) {
+        if (entries[i].state == RESULT_CACHE_DONE) {
+            *result = &entries[i].result;
+            *report = &entries[i].report;
+            result_cache_stats.replays++;
+        } else {
+            result_cache_stats.coalesced++;
+        }
+        return (result_cache_state_t)entries[i].state;
+    }
+
+    i = result_cache_slot();
+    if (i == NO_ENTRY) {
+        result_cache_stats.untracked++;
+        return RESULT_CACHE_MISS;
+    }
+
+    ip_addr_copy(entries[i].addr, *addr);
+    entries[i].port = port;
+    entries[i].test_id = test_id;
+    entries[i].state = RESULT_CACHE_IN_FLIGHT;
+    h = result_cache_hash(addr, port, test_id);
+    entries[i].next = buckets[h];
+    buckets[h] = i;
+    return RESULT_CACHE_MISS;
+}
+
+/**
+ * @brief Forgets a command that was claimed but could not be queued.
+ */
+void result_cache_release(const ip_addr_t* addr, u16_t port, uint32_t test_id) {
+    uint8_t i = initialised ? result_cache_find(addr, port, test_id) : NO_ENTRY;
+
+    if (i != NO_ENTRY && entries[i].state == RESULT_CACHE_IN_FLIGHT) {
+        result_cache_unlink(i);
+    }
+}
+
+/**
+ * @brief Stores the result of a tracked command for later duplicates.
+ */
+void result_cache_complete(const ip_addr_t* addr, u16_t port, result_pro_t result, const test_report_t* report) {
+    uint8_t i = initialised ? result_cache_find(addr, port, result.test_id) : NO_ENTRY;
+
+    if (i == NO_ENTRY || entries[i].state != RESULT_CACHE_IN_FLIGHT) {
+        return;
+    }
+    entries[i].result = result;
+    entries[i].report.length = (report != NULL) ? report->length : 0;
+    if (entries[i].report.length > 0) {
+        memcpy(entries[i].report.data, report->data, entries[i].report.length);
+    }
+    entries[i].finished = sys_now();
+    entries[i].state = RESULT_CACHE_DONE;
+}
@@ -14,24 +14,8 @@
 extern SPI_HandleTypeDef hspi1;
 extern SPI_HandleTypeDef hspi4;
 
-/**
- * @brief Macro for 32-byte alignment to match Cortex-M7 Cache line size.
- */
-#define ALIGN_32 __attribute__((aligned(32)))
-
-/**
- * @brief Macro to round length up to the nearest 32-byte boundary for cache maintenance.
- */
-#define CACHE_ROUND(x) (((x) + 31) & ~31)
-
-/* * DMA Buffers
- * Static allocation ensures persistence during transfer.
- * Alignment ensures cache operations do not corrupt adjacent variables.
- */
-static uint8_t echo_rx_buffer[MAX_BIT_PATTERN_LENGTH] ALIGN_32;
-static uint8_t echo_tx_buffer[MAX_BIT_PATTERN_LENGTH] ALIGN_32;
-static uint8_t master_tx[MAX_BIT_PATTERN_LENGTH] ALIGN_32;
-static uint8_t master_rx[MAX_BIT_PATTERN_LENGTH] ALIGN_32;
+static Result spi_loopback(test_command_t* command, uint8_t* master_tx, uint8_t* master_rx,
+                           uint8_t* echo_tx_buffer, uint8_t* echo_rx_buffer);
 
 /**
  * @brief Performs hardware verification on SPI peripherals.
@@ -45,6 +29,32 @@ Result spi_testing(test_command_t* command)
 {
     if (command == NULL || command->bit_pattern_length > MAX_BIT_PATTERN_LENGTH) return TEST_ERR;
 
+    /*
+     * DMA Buffers
+     * Leased from the shared arena: they persist for the whole transfer, and
+     * cache-line alignment ensures cache operations do not corrupt adjacent data.
+     */
+    dma_arena_mark_t mark = dma_arena_mark();
+    uint8_t* master_tx = dma_arena_lease(command->bit_pattern_length);
+    uint8_t* master_rx = dma_arena_lease(command->bit_pattern_length);
+    uint8_t* echo_tx_buffer = dma_arena_lease(command->bit_pattern_length);
+    uint8_t* echo_rx_buffer = dma_arena_lease(command->bit_pattern_length);
+    Result result = TEST_FAIL;
+
+    if (master_tx != NULL && master_rx != NULL && echo_tx_buffer != NULL && echo_rx_buffer != NULL) {
+        result = spi_loopback(command, master_tx, master_rx, echo_tx_buffer, echo_rx_buffer);
+    }
+
+    dma_arena_release(mark);
+    return result;
+}
+
+/**
+ * @brief Runs the two-phase loopback iterations on leased buffers.
+ */
+static Result spi_loopback(test_command_t* command, uint8_t* master_tx, uint8_t* master_rx,
+                           uint8_t* echo_tx_buffer, uint8_t* echo_rx_buffer)
+{
     uint16_t len = command->bit_pattern_length;
     uint32_t clean_len = CACHE_ROUND(len);
 
@@ -56,6 +66,9 @@ Result spi_testing(test_command_t* command)
 
     for (uint8_t iter = 0; iter < command->iterations; ++iter)
     {
+        if (test_checkpoint(iter)) {
+            return TEST_ABORTED;
+        }
         reset_test();
         memset(master_rx, 0, len);
         memset(echo_rx_buffer, 0, len);
@@ -64,6 +77,10 @@ Result spi_testing(test_command_t* command)
         SCB_CleanInvalidateDCache_by_Addr((uint32_t*)echo_rx_buffer, clean_len);
         SCB_CleanInvalidateDCache_by_Addr((uint32_t*)master_rx, clean_len);
 
+        // Drain stale completions, an aborted test may have left one
+        xSemaphoreTake(SpiSlaveRxHandle, 0);
+        xSemaphoreTake(SpiRxHandle, 0);
+
         /* --- PHASE 1: Master -> Slave --- */
         HAL_SPI_Receive_DMA(SPI_RECEIVER, echo_rx_buffer, len);
         osDelay(2); // Wait for DMA setup
@@ -72,7 +89,8 @@ Result spi_testing(test_command_t* command)
         HAL_SPI_Transmit(SPI_SENDER, master_tx, len, TIMEOUT);
         HAL_GPIO_WritePin(CS_GPIO_Port, CS_Pin, GPIO_PIN_SET);
 
-        if (xSemaphoreTake(SpiSlaveRxHandle, TIMEOUT) != pdPASS) {
+        if (test_wait(SpiSlaveRxHandle, TIMEOUT) != pdPASS) {
+            reset_test();
             return TEST_FAIL;
         }
 
@@ -95,7 +113,8 @@ Result spi_testing(test_command_t* command)
         // Final Cache Sync for Master Reception
         SCB_InvalidateDCache_by_Addr((uint32_t*)master_rx, clean_len);
 
-        if (xSemaphoreTake(SpiRxHandle, TIMEOUT) != pdPASS) {
+        if (test_wait(SpiRxHandle, TIMEOUT) != pdPASS) {
+            reset_test();
             return TEST_FAIL;
         }
 
@@ -0,0 +1,340 @@
+/**
+ * @file tcp_channel.c
+ * @brief Length-prefixed command stream over a raw-API TCP connection.
+ */
+
+#include "tcp_channel.h"
+
+#include <string.h>
+
+#include "main.h"
+#include "cmd_sessions.h"
+#include "lwip/tcp.h"
+
+#define TCP_POLL_INTERVAL   2       // tcp_tmr ticks (500 ms), retries a stalled parse
+
+typedef struct tcp_channel_t {
+    struct tcp_pcb* pcb;            // Connected client, NULL when none
+    struct pbuf* rx;                // Received bytes not yet handed to the executor
+    struct pbuf* tx;                // Result bytes not yet written, the send buffer was full
+    uint16_t generation;            // Bumped per connection, stale results are dropped
+    uint16_t outstanding;           // Commands submitted, results not yet written
+    uint8_t closing;                // Client sent FIN, close once the results are out
+    uint8_t session;                // The client's cmd_sessions index
+} tcp_channel_t;
+
+tcp_channel_stats_t tcp_channel_stats;
+
+static tcp_channel_t channel;
+
+/* The tag a queued command carries back to tcp_channel_send_result */
+#define TCP_TAG(generation, frame_length)   (((uint32_t)(generation) << 16) | (frame_length))
+#define TCP_TAG_GENERATION(tag)             ((uint16_t)((tag) >> 16))
+#define TCP_TAG_FRAME_LENGTH(tag)           ((uint16_t)((tag) & 0xFFFFU))
+
+static err_t tcp_channel_accept(void* arg, struct tcp_pcb* pcb, err_t err);
+static err_t tcp_channel_recv(void* arg, struct tcp_pcb* pcb, struct pbuf* p, err_t err);
+static err_t tcp_channel_poll(void* arg, struct tcp_pcb* pcb);
+static err_t tcp_channel_sent(void* arg, struct tcp_pcb* pcb, u16_t len);
+static void tcp_channel_error(void* arg, err_t err);
+static err_t tcp_channel_parse(void);
+static err_t tcp_channel_close(void);
+static err_t tcp_channel_write(result_pro_t result, const test_report_t* report);
+static void tcp_channel_flush(void);
+
+/**
+ * @brief Opens the listener on TCP_COMMAND_PORT.
+ */
+void tcp_channel_init(void) {
+    struct tcp_pcb* pcb = tcp_new();
+
+    if (pcb == NULL) {
+        return;
+    }
+    if (tcp_bind(pcb, IP_ADDR_ANY, TCP_COMMAND_PORT) != ERR_OK) {
+        tcp_close(pcb);
+        return;
+    }
+    pcb = tcp_listen_with_backlog(pcb, 1);
+    if (pcb != NULL) {
+        tcp_accept(pcb, tcp_channel_accept);
+    }
+}
+
+/**
+ * @brief Writes one result frame and opens the window by the command's frame.
+ * @param tag The tag the command was submitted with.
+ * @param more Non-zero when further results are about to follow: the frame is
+ * then left for the next write to flush, so a burst of small results shares
+ * segments instead of costing one each.
+ * @return 0 when written or held, -1 if the result was dropped.
+ */
+int tcp_channel_send_result(result_pro_t result, const test_report_t* report, uint32_t tag, uint8_t more) {
+    err_t err;
+
+    if (channel.pcb == NULL || TCP_TAG_GENERATION(tag) != channel.generation) {
+        tcp_channel_stats.result_drops++;
+        return -1;
+    }
+    channel.outstanding--;
+
+    err = tcp_channel_write(result, report);
+
+    // The command is done either way, its bytes leave the window
+    tcp_recved(channel.pcb, TCP_TAG_FRAME_LENGTH(tag));
+    if (!more) {
+        tcp_output(channel.pcb);
+    }
+
+    // A queue slot just freed up, resume a stalled parse
+    if (tcp_channel_parse() == ERR_OK && channel.closing && channel.outstanding == 0 && channel.tx == NULL) {
+        tcp_channel_close();
+    }
+
+    if (err != ERR_OK) {
+        tcp_channel_stats.result_drops++;
+        return -1;
+    }
+    tcp_channel_stats.results++;
+    return 0;
+}
+
+/**
+ * @brief Send buffer bytes a write can use now, 0 when the segment queue is full too.
+ */
+static uint16_t tcp_channel_room(void) {
+    return (tcp_sndqueuelen(channel.pcb) < TCP_SND_QUEUELEN) ? tcp_sndbuf(channel.pcb) : 0;
+}
+
+/**
+ * @brief Queues one result frame on the connection, without sending it yet.
+ * The frame is one tcp_write, a failure cannot leave half of it in the
+ * stream. Without room, or behind frames already held, it is held too.
+ * @return ERR_MEM when there was no memory to hold it, the result is lost.
+ */
+static err_t tcp_channel_write(result_pro_t result, const test_report_t* report) {
+    static uint8_t frame[TCP_FRAME_HEADER_LENGTH + sizeof(result_pro_t) + MAX_REPORT_LENGTH];  // Under the core lock
+    uint16_t report_length = (report != NULL) ? LWIP_MIN(report->length, MAX_REPORT_LENGTH) : 0;
+    uint16_t length = sizeof(result_pro_t) + report_length;
+    struct pbuf* held;
+
+    memcpy(frame, &length, TCP_FRAME_HEADER_LENGTH);
+    memcpy(&frame[TCP_FRAME_HEADER_LENGTH], &result, sizeof(result_pro_t));
+    if (report_length > 0) {
+        memcpy(&frame[TCP_FRAME_HEADER_LENGTH + sizeof(result_pro_t)], report->data, report_length);
+    }
+    length += TCP_FRAME_HEADER_LENGTH;
+
+    // Held frames go first, the stream stays in order
+    tcp_channel_flush();
+    if (channel.tx == NULL && tcp_channel_room() >= length
+        && tcp_write(channel.pcb, frame, length, TCP_WRITE_FLAG_COPY) == ERR_OK) {
+        return ERR_OK;
+    }
+
+    held = pbuf_alloc(PBUF_RAW, length, PBUF_RAM);
+    if (held == NULL) {
+        return ERR_MEM;
+    }
+    memcpy(held->payload, frame, length);
+    if (channel.tx == NULL) {
+        channel.tx = held;
+    } else {
+        pbuf_cat(channel.tx, held);
+    }
+    tcp_channel_stats.held++;
+    return ERR_OK;
+}
+
+/**
+ * @brief Writes held result bytes as far as the send buffer allows. They
+ * are already in stream order, so a frame may go out over several writes.
+ */
+static void tcp_channel_flush(void) {
+    uint16_t length;
+
+    while (channel.tx != NULL) {
+        length = LWIP_MIN(channel.tx->len, tcp_channel_room());
+        if (length == 0 || tcp_write(channel.pcb, channel.tx->payload, length, TCP_WRITE_FLAG_COPY) != ERR_OK) {
+            break;
+        }
+        channel.tx = pbuf_free_header(channel.tx, length);
+    }
+}
+
+static err_t tcp_channel_accept(void* arg, struct tcp_pcb* pcb, err_t err) {
+    if (err != ERR_OK || pcb == NULL) {
+        return ERR_VAL;
+    }
+    if (channel.pcb != NULL) {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    channel.session = cmd_session_open(CMD_ORIGIN_TCP, &pcb->remote_ip, pcb->remote_port);
+    if (channel.session == CMD_SESSION_NONE) {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+
+    channel.pcb = pcb;
+    channel.rx = NULL;
+    channel.tx = NULL;
+    channel.outstanding = 0;
+    channel.closing = 0;
+    channel.generation++;
+    tcp_channel_stats.connections++;
+
+    // Results are flushed explicitly once a burst is over, Nagle would only delay the last one
+    tcp_nagle_disable(pcb);
+    tcp_recv(pcb, tcp_channel_recv);
+    tcp_err(pcb, tcp_channel_error);
+    tcp_poll(pcb, tcp_channel_poll, TCP_POLL_INTERVAL);
+    tcp_sent(pcb, tcp_channel_sent);
+    return ERR_OK;
+}
+
+static err_t tcp_channel_recv(void* arg, struct tcp_pcb* pcb, struct pbuf* p, err_t err) {
+    if (p == NULL) {
+        // Client closed its side, results still owed go out first
+        channel.closing = 1;
+        return (channel.outstanding == 0 && channel.tx == NULL) ? tcp_channel_close() : ERR_OK;
+    }
+    if (err != ERR_OK) {
+        pbuf_free(p);
+        return err;
+    }
+
+    if (channel.rx == NULL) {
+        channel.rx = p;
+    } else {
+        pbuf_cat(channel.rx, p);
+    }
+    return tcp_channel_parse();
+}
+
+static err_t tcp_channel_poll(void* arg, struct tcp_pcb* pcb) {
+    tcp_channel_flush();
+    return tcp_channel_parse();
+}
+
+static err_t tcp_channel_sent(void* arg, struct tcp_pcb* pcb, u16_t len) {
+    // Acknowledged data made room, held results go next
+    tcp_channel_flush();
+    if (channel.tx != NULL) {
+        return ERR_OK;
+    }
+    if (channel.closing && channel.outstanding == 0) {
+        return tcp_channel_close();
+    }
+    return tcp_channel_parse();
+}
+
+static void tcp_channel_error(void* arg, err_t err) {
+    // lwIP has already freed the pcb
+    if (channel.pcb != NULL) {
+        cmd_session_close(channel.session);
+    }
+    channel.pcb = NULL;
+    if (channel.rx != NULL) {
+        pbuf_free(channel.rx);
+        channel.rx = NULL;
+    }
+    if (channel.tx != NULL) {
+        pbuf_free(channel.tx);
+        channel.tx = NULL;
+    }
+}
+
+/**
+ * @brief Hands every complete command frame to the executor until the
+ * buffer runs out or the client's share of testsQ is used up. A test that
+ * would miss its deadline is answered TEST_DEADLINE here instead.
+ * @return ERR_ABRT if a malformed frame aborted the connection, else ERR_OK.
+ */
+static err_t tcp_channel_parse(void) {
+    static test_command_t cmd;      // tcpip thread only, keeps it off that stack
+    test_sched_t sched;
+    uint8_t answered = 0;
+    uint16_t length;
+    int submitted;
+
+    while (channel.rx != NULL && channel.rx->tot_len >= TCP_FRAME_HEADER_LENGTH) {
+        if (channel.tx != NULL) {
+            // The client is not reading its results, stop taking its commands
+            tcp_channel_stats.stalls++;
+            break;
+        }
+        pbuf_copy_partial(channel.rx, &length, TCP_FRAME_HEADER_LENGTH, 0);
+        if (length < TCP_COMMAND_MIN_LENGTH
+            || (length > sizeof(test_command_t) && length != TCP_COMMAND_MAX_LENGTH)) {
+            // Out of sync with the stream, nothing after this can be trusted.
+            // tcp_abort calls tcp_channel_error, which forgets the connection
+            tcp_abort(channel.pcb);
+            return ERR_ABRT;
+        }
+        if (channel.rx->tot_len < TCP_FRAME_HEADER_LENGTH + length) {
+            break;
+        }
+
+        // A short command stops after its bit pattern, the rest reads as zero
+        memset(&cmd, 0, sizeof(cmd));
+        pbuf_copy_partial(channel.rx, &cmd, LWIP_MIN(length, sizeof(cmd)), TCP_FRAME_HEADER_LENGTH);
+        if (length == TCP_COMMAND_MAX_LENGTH) {
+            pbuf_copy_partial(channel.rx, &sched, sizeof(sched), TCP_FRAME_HEADER_LENGTH + sizeof(cmd));
+        }
+        submitted = command_submit(&cmd, (length == TCP_COMMAND_MAX_LENGTH) ? &sched : NULL, channel.session,
+                                   TCP_TAG(channel.generation, TCP_FRAME_HEADER_LENGTH + length), 0);
+        if (submitted == CMD_SUBMIT_REFUSED) {
+            tcp_channel_stats.stalls++;
+            break;
+        }
+        tcp_channel_stats.commands++;
+        channel.rx = pbuf_free_header(channel.rx, TCP_FRAME_HEADER_LENGTH + length);
+
+        if (submitted == CMD_SUBMIT_LATE) {
+            // Never queued, so it is answered and leaves the window right away
+            result_pro_t late = {cmd.test_id, TEST_DEADLINE};
+
+            if (tcp_channel_write(late, NULL) == ERR_OK) {
+                tcp_channel_stats.results++;
+            } else {
+                tcp_channel_stats.result_drops++;
+            }
+            tcp_recved(channel.pcb, TCP_FRAME_HEADER_LENGTH + length);
+            answered = 1;
+            continue;
+        }
+        channel.outstanding++;
+    }
+    if (answered) {
+        tcp_output(channel.pcb);
+    }
+
+    // Held bytes would pin zero-copy RX buffers, one per segment: move them to the heap
+    if (channel.rx != NULL && channel.rx->next != NULL) {
+        channel.rx = pbuf_coalesce(channel.rx, PBUF_RAW);
+    }
+    return ERR_OK;
+}
+
+/**
+ * @brief Closes the connection, unparsed bytes are discarded.
+ * @return ERR_ABRT if the close had to fall back to an abort, else ERR_OK.
+ */
+static err_t tcp_channel_close(void) {
+    struct tcp_pcb* pcb = channel.pcb;
+
+    tcp_channel_error(NULL, ERR_CLSD);
+    if (pcb == NULL) {
+        return ERR_OK;
+    }
+    tcp_recv(pcb, NULL);
+    tcp_err(pcb, NULL);
+    tcp_poll(pcb, NULL, 0);
+    tcp_sent(pcb, NULL);
+    if (tcp_close(pcb) != ERR_OK) {
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    return ERR_OK;
+}
@@ -0,0 +1,201 @@
+/**
+ * @file test_abort.c
+ * @brief CMD_ABORT: stops the running test at its next iteration or wait.
+ */
+
+#include "test_abort.h"
+
+#include "task.h"
+
+typedef struct test_abort_state_t {
+    uint32_t test_id;               // Running command, 0 when idle
+    uint8_t session;
+    uint8_t iterations;             // Requested by the command
+    uint32_t iterations_done;       // Last checkpoint
+    uint32_t start_ms;
+    SemaphoreHandle_t waiting;      // Semaphore the test is blocked on, if any
+    volatile uint8_t requested;     // Abort asked for
+    uint8_t observed;               // The test stopped for it
+    uint8_t unreported;             // Ended with an abort asked for, its result not sent yet
+} test_abort_state_t;
+
+typedef struct test_abort_cancel_t {
+    uint32_t test_id;               // 0 when the slot is free
+    uint8_t session;
+} test_abort_cancel_t;
+
+static test_abort_state_t running;
+static test_abort_cancel_t cancelled[TEST_ABORT_CANCELLED];
+static uint8_t cancel_next;         // Oldest slot, overwritten when all are in use
+static void* held[TEST_ABORT_HELD]; // Abort answers waiting for the test's result, oldest first
+static uint8_t held_count;
+
+/**
+ * @brief Aborts a client's command: at once if running, when dequeued if not.
+ * @param test_id The command to abort, or 0 for the running one whoever sent it.
+ * @return TEST_PASS when the command was running, TEST_FAIL when it was not
+ * (it is then cancelled in case it is still queued).
+ */
+Result test_abort_request(uint8_t session, uint32_t test_id) {
+    Result result = TEST_FAIL;
+
+    // The executor cannot run until the give is done, so the semaphore is
+    // still the one this test waits on, not one a later test reuses
+    vTaskSuspendAll();
+    if (running.test_id != 0 && (test_id == 0 || (running.test_id == test_id && running.session == session))) {
+        // Set before reading waiting, test_wait does the opposite, so one of them sees the other
+        running.requested = 1;
+        if (running.waiting != NULL) {
+            xSemaphoreGive(running.waiting);
+        }
+        result = TEST_PASS;
+    }
+    xTaskResumeAll();
+
+    if (result == TEST_PASS || test_id == 0) {
+        return result;
+    }
+
+    cancelled[cancel_next].test_id = test_id;
+    cancelled[cancel_next].session = session;
+    cancel_next = (cancel_next + 1) % TEST_ABORT_CANCELLED;
+    return TEST_FAIL;
+}
+
+/**
+ * @brief Tells whether a dequeued command was aborted before it ran, and forgets it.
+ */
+uint8_t test_abort_cancelled(uint8_t session, uint32_t test_id) {
+    uint8_t found = 0;
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < TEST_ABORT_CANCELLED; i++) {
+        if (cancelled[i].test_id == test_id && cancelled[i].session == session && test_id != 0) {
+            cancelled[i].test_id = 0;
+            found = 1;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return found;
+}
+
+/**
+ * @brief Marks a command as running, aborts now target it.
+ */
+void test_abort_begin(uint8_t session, const test_command_t* command) {
+    taskENTER_CRITICAL();
+    running.test_id = command->test_id;
+    running.session = session;
+    running.iterations = command->iterations;
+    running.iterations_done = 0;
+    running.start_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    running.waiting = NULL;
+    running.requested = 0;
+    running.observed = 0;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Ends the command. If it stopped for an abort, replaces its report.
+ * @return 1 when the test was aborted, its result is then TEST_ABORTED.
+ */
+uint8_t test_abort_end(test_report_t* report) {
+    test_abort_report_t* partial = (test_abort_report_t*)report->data;
+    uint8_t aborted;
+
+    taskENTER_CRITICAL();
+    aborted = running.observed;
+    running.unreported = running.requested;
+    running.test_id = 0;
+    taskEXIT_CRITICAL();
+
+    if (!aborted) {
+        return 0;
+    }
+    partial->iterations_done = running.iterations_done;
+    partial->iterations_requested = running.iterations;
+    partial->elapsed_ms = xTaskGetTickCount() * portTICK_PERIOD_MS - running.start_ms;
+    report->length = sizeof(test_abort_report_t);
+    return 1;
+}
+
+/**
+ * @brief Hands back, one per call, the abort answers held for the test just reported.
+ * @details Called by the executor once the test's result is sent, until it
+ * returns NULL; aborts that arrive later are answered by probe_task at once.
+ * @return The answer passed to test_abort_hold(), or NULL when none is left.
+ */
+void* test_abort_reported(void) {
+    void* answer = NULL;
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    if (held_count > 0) {
+        answer = held[0];
+        held_count--;
+        for (i = 0; i < held_count; i++) {
+            held[i] = held[i + 1];
+        }
+    } else {
+        running.unreported = 0;
+    }
+    taskEXIT_CRITICAL();
+    return answer;
+}
+
+/**
+ * @brief Holds an abort's answer until the aborted test's result has been sent.
+ * @return 1 when held, the executor then answers it; 0 when the result is
+ * already out or no slot is free, the caller answers it now.
+ */
+uint8_t test_abort_hold(void* answer) {
+    uint8_t held_back = 0;
+
+    taskENTER_CRITICAL();
+    if (((running.test_id != 0 && running.requested) || running.unreported) && held_count < TEST_ABORT_HELD) {
+        held[held_count++] = answer;
+        held_back = 1;
+    }
+    taskEXIT_CRITICAL();
+    return held_back;
+}
+
+/**
+ * @brief Records progress between iterations.
+ * @param iterations_done Iterations completed so far.
+ * @return 1 when the test must stop for an abort.
+ */
+uint8_t test_checkpoint(uint32_t iterations_done) {
+    running.iterations_done = iterations_done;
+    if (running.requested) {
+        running.observed = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief xSemaphoreTake() that an abort cuts short.
+ * @return pdPASS when the semaphore was given, pdFAIL on timeout or abort;
+ * the test takes its failure path either way.
+ */
+BaseType_t test_wait(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    BaseType_t status;
+
+    running.waiting = semaphore;
+    if (running.requested) {
+        running.waiting = NULL;
+        running.observed = 1;
+        return pdFAIL;
+    }
+    status = xSemaphoreTake(semaphore, timeout);
+    running.waiting = NULL;
+
+    if (running.requested) {
+        running.observed = 1;
+        return pdFAIL;
+    }
+    return status;
+}
@@ -4,47 +4,671 @@
  * * Design Decision:
  * This test verifies the hardware's ability to generate periodic interrupts.
  * The Timer is configured to fire at a specific frequency (e.g., every 100ms).
- * The test passes if the CPU receives the expected number of interrupts
- * within the allowed time window.
+ * Both the TIM7 callback and the waiting task timestamp each pulse with the
+ * DWT cycle counter, so the test measures the actual period, its jitter and
+ * the ISR-to-task wake latency, and fails when any of them exceeds its limit.
+ * The wake latency doubles as the board's scheduler-latency figure.
+ * * The stress variant (TIMER_STRESS) reprograms TIM7 to a commanded rate of
+ * up to hundreds of kHz. There the ISR only counts pulses and signals the task
+ * once at the end of a burst, so the count error shows the highest interrupt
+ * rate the board can sustain.
+ * * The PWM loopback (TIMER_PWM) checks a timer's output instead: TIM3
+ * generates PWM at a commanded frequency and duty cycle, and TIM1 in PWM input
+ * mode measures every period and high time in hardware. A DMA burst on each
+ * capture moves both values to memory, so thousands of periods are measured
+ * without any interrupt per edge.
+ * * Hardware Connection Requirement (TIMER_PWM only):
+ * TIM3                             TIM1
+ * PC6 [TIM3_CH1] (CN7) ----------> PE9 [TIM1_CH1] (CN10)
  */
 
 #include "timer_test.h"
 
+/* DWT->CYCCNT at the last TIM7 update, written by HAL_TIM_PeriodElapsedCallback */
+volatile uint32_t tim7_isr_cycles;
+
+/* Stress burst state: the ISR counts up to the target, 0 = no stress test running */
+volatile uint32_t timer_stress_target;
+static volatile uint32_t stress_count;
+static volatile uint32_t stress_end_cycles;
+
+/* PWM loopback resources: TIM3 generates, TIM1 captures, DMA2 Stream6 moves CCR1/CCR2 pairs */
+DMA_HandleTypeDef hdma_tim1_ch1;
+static TIM_HandleTypeDef htim1;
+static TIM_HandleTypeDef htim3;
+
+static uint16_t pwm_capture[2U * (TIMER_PWM_MAX_PERIODS + TIMER_PWM_DISCARD)] ALIGN_32;
+
+static void timer_limits_from_command(const test_command_t* command, timer_limits_t* limits);
+static HAL_StatusTypeDef timer_stress_configure(const timer_stress_config_t* config);
+static HAL_StatusTypeDef timer_pwm_init(void);
+static HAL_StatusTypeDef timer_pwm_configure(const timer_pwm_config_t* config);
+static void timer_pwm_stop(void);
+
 /**
  * @brief Performs a hardware verification test on the TIMER peripheral.
+ * * One extra pulse is awaited first to serve as the period reference, then
+ * every iteration measures one period and one wake latency.
+ * TIMER_LIMITS takes the limits from the bit pattern (see timer_limits_t).
  * * @param command Pointer to the test_command_t structure.
- * @return Result TEST_PASS if the timer pulses are received correctly,
- * TEST_FAIL if a timeout occurs, TEST_ERR for null input.
+ * @param report Receives a timer_jitter_report_t summary.
+ * @return Result TEST_PASS if the timer pulses are received within limits,
+ * TEST_FAIL if a timeout occurs or a limit is exceeded, TEST_ERR for null input.
  */
-Result timer_testing(test_command_t* command) {
+Result timer_testing(test_command_t* command, test_report_t* report) {
+    timer_jitter_report_t summary = {0};
+    timer_limits_t limits;
+    uint32_t expected, period, latency, previous_isr, wake;
+    uint32_t cycles_per_us, max_error;
+    uint64_t period_sum = 0, latency_sum = 0;
+    Result result = TEST_PASS;
 
-    if (command == NULL) {
+    if (command == NULL || report == NULL) {
         return TEST_ERR;
     }
 
+    timer_limits_from_command(command, &limits);
+    dwt_cycle_counter_init();
+
+    // Nominal period in CPU cycles
+    expected = (uint32_t)(((uint64_t)(htim7.Instance->PSC + 1U) * (htim7.Instance->ARR + 1U) *
+                           SystemCoreClock) / timer_apb1_clock());
+    cycles_per_us = SystemCoreClock / 1000000U;
+
+    summary.core_clock_hz = SystemCoreClock;
+    summary.expected_period_cycles = expected;
+    summary.min_period_cycles = UINT32_MAX;
+
+    xSemaphoreTake(TimSemHandle, 0);
+
     // Start Timer in Interrupt mode
     if (HAL_TIM_Base_Start_IT(&htim7) != HAL_OK) {
         return TEST_FAIL;
     }
 
+    /*
+     * Wait for the Timer Callback to give the semaphore.
+     * The timeout (200ms) acts as a "Watchdog". If the timer hardware
+     * fails to pulse, the test fails.
+     */
+    if (test_wait(TimSemHandle, pdMS_TO_TICKS(200)) != pdPASS) {
+        HAL_TIM_Base_Stop_IT(&htim7);
+        return TEST_FAIL;
+    }
+    previous_isr = tim7_isr_cycles;
+
     for (uint8_t i = 0; i < command->iterations; i++) {
-        /*
-         * Wait for the Timer Callback to give the semaphore.
-         * The timeout (200ms) acts as a "Watchdog". If the timer hardware
-         * fails to pulse, the test fails.
-         */
-        if (xSemaphoreTake(TimSemHandle, pdMS_TO_TICKS(200)) != pdPASS) {
-            HAL_TIM_Base_Stop_IT(&htim7);
-            return TEST_FAIL;
+        if (test_checkpoint(i)) {
+            result = TEST_ABORTED;
+            break;
         }
+        if (test_wait(TimSemHandle, pdMS_TO_TICKS(200)) != pdPASS) {
+            result = TEST_FAIL;
+            break;
+        }
+        wake = DWT->CYCCNT;
+
+        // Unsigned differences stay correct across CYCCNT wrap-around
+        period = tim7_isr_cycles - previous_isr;
+        latency = wake - tim7_isr_cycles;
+        previous_isr = tim7_isr_cycles;
 
-        // Pacing delay between pulse verifications
-        osDelay(1);
+        if (period < summary.min_period_cycles) {
+            summary.min_period_cycles = period;
+        }
+        if (period > summary.max_period_cycles) {
+            summary.max_period_cycles = period;
+        }
+        if (latency > summary.max_latency_cycles) {
+            summary.max_latency_cycles = latency;
+        }
+        period_sum += period;
+        latency_sum += latency;
+        summary.samples++;
     }
 
     // Stop Timer after the verification iterations are complete
     HAL_TIM_Base_Stop_IT(&htim7);
 
-    return TEST_PASS;
+    if (summary.samples > 0) {
+        summary.mean_period_cycles = (uint32_t)(period_sum / summary.samples);
+        summary.mean_latency_cycles = (uint32_t)(latency_sum / summary.samples);
+        summary.jitter_cycles = summary.max_period_cycles - summary.min_period_cycles;
+
+        // Worst single period against the nominal one
+        max_error = (summary.max_period_cycles > expected) ? summary.max_period_cycles - expected : 0;
+        if (summary.min_period_cycles < expected && expected - summary.min_period_cycles > max_error) {
+            max_error = expected - summary.min_period_cycles;
+        }
+        summary.max_period_error_ppm = (uint32_t)(((uint64_t)max_error * 1000000U) / expected);
+
+        if (summary.max_period_error_ppm > limits.max_period_error_ppm ||
+            summary.jitter_cycles > limits.max_jitter_us * cycles_per_us ||
+            summary.max_latency_cycles > limits.max_latency_us * cycles_per_us) {
+            result = TEST_FAIL;
+        }
+    }
+    else {
+        summary.min_period_cycles = 0;
+    }
+
+    memcpy(report->data, &summary, sizeof(summary));
+    report->length = sizeof(summary);
+
+    return result;
 }
 
+/**
+ * @brief High-frequency TIM7 interrupt stress test.
+ * * The bit pattern carries a timer_stress_config_t: a target frequency, or
+ * an explicit prescaler/period when the frequency is 0, and the burst length.
+ * Every iteration runs one burst; pulses the ISR could not service show up as
+ * missed pulses against the elapsed DWT time.
+ * * @param command Pointer to the test_command_t structure.
+ * @param report Receives a timer_stress_report_t summary.
+ * @return Result TEST_PASS if no burst missed more than TIMER_STRESS_MAX_MISSED pulses,
+ * TEST_FAIL on timeout or missed pulses, TEST_ERR for null input or an invalid configuration.
+ */
+Result timer_stress_testing(test_command_t* command, test_report_t* report) {
+    timer_stress_report_t summary = {0};
+    timer_stress_config_t config = {0};
+    TIM_Base_InitTypeDef saved_init;
+    uint32_t start, elapsed, timeout_ms, rate;
+    uint64_t divider, expected;
+    Result result = TEST_PASS;
+
+    if (command == NULL || report == NULL) {
+        return TEST_ERR;
+    }
+
+    if (command->bit_pattern_length >= sizeof(config)) {
+        memcpy(&config, command->bit_pattern, sizeof(config));
+    }
+    if (config.pulses == 0) {
+        config.pulses = TIMER_STRESS_DEFAULT_PULSES;
+    }
+    if (config.frequency_hz > TIMER_STRESS_MAX_FREQUENCY_HZ ||
+        (config.frequency_hz == 0 && config.period == 0)) {
+        return TEST_ERR;
+    }
+
+    dwt_cycle_counter_init();
+    saved_init = htim7.Init;
+
+    if (timer_stress_configure(&config) != HAL_OK) {
+        htim7.Init = saved_init;
+        HAL_TIM_Base_Init(&htim7);
+        return TEST_ERR;
+    }
+
+    // 64 bits: a large explicit prescaler and period would wrap the product to 0
+    divider = (uint64_t)(htim7.Init.Prescaler + 1U) * (htim7.Init.Period + 1U);
+    summary.frequency_hz = (uint32_t)(timer_apb1_clock() / divider);
+    if (summary.frequency_hz == 0) {
+        // Below 1 Hz, the rate would divide by zero below
+        htim7.Init = saved_init;
+        HAL_TIM_Base_Init(&htim7);
+        return TEST_ERR;
+    }
+    summary.prescaler = (uint16_t)htim7.Init.Prescaler;
+    summary.period = (uint16_t)htim7.Init.Period;
+    summary.pulses = config.pulses;
+    summary.min_rate_hz = UINT32_MAX;
+
+    // Twice the nominal burst time, plus scheduling margin
+    timeout_ms = (uint32_t)(((uint64_t)config.pulses * 2000U) / summary.frequency_hz) + 100U;
+
+    for (uint8_t i = 0; i < command->iterations; i++) {
+        if (test_checkpoint(i)) {
+            result = TEST_ABORTED;
+            break;
+        }
+        xSemaphoreTake(TimSemHandle, 0);
+        stress_count = 0;
+        timer_stress_target = config.pulses;
+        __HAL_TIM_SET_COUNTER(&htim7, 0);
+        __HAL_TIM_CLEAR_FLAG(&htim7, TIM_FLAG_UPDATE);  // Pending update from the reconfiguration
+
+        start = DWT->CYCCNT;
+        if (HAL_TIM_Base_Start_IT(&htim7) != HAL_OK) {
+            result = TEST_FAIL;
+            break;
+        }
+
+        if (test_wait(TimSemHandle, pdMS_TO_TICKS(timeout_ms)) != pdPASS) {
+            HAL_TIM_Base_Stop_IT(&htim7);
+            result = TEST_FAIL;
+            break;
+        }
+        HAL_TIM_Base_Stop_IT(&htim7);
+
+        // Updates the hardware generated in the time the ISR took to count the burst
+        elapsed = stress_end_cycles - start;
+        expected = ((uint64_t)elapsed * timer_apb1_clock()) / (SystemCoreClock * divider);
+        if (expected > config.pulses && expected - config.pulses > summary.max_missed) {
+            summary.max_missed = (uint32_t)(expected - config.pulses);
+        }
+
+        rate = (uint32_t)(((uint64_t)config.pulses * SystemCoreClock) / elapsed);
+        if (rate < summary.min_rate_hz) {
+            summary.min_rate_hz = rate;
+        }
+        summary.bursts++;
+    }
+
+    timer_stress_target = 0;
+    htim7.Init = saved_init;
+    HAL_TIM_Base_Init(&htim7);
+
+    if (summary.bursts == 0) {
+        summary.min_rate_hz = 0;
+    }
+    if (summary.max_missed > TIMER_STRESS_MAX_MISSED) {
+        result = TEST_FAIL;
+    }
+
+    memcpy(report->data, &summary, sizeof(summary));
+    report->length = sizeof(summary);
+
+    return result;
+}
+
+/**
+ * @brief Counts one stress pulse; called from the TIM7 update callback.
+ * * At the end of the burst the update interrupt is masked and the task is
+ * signalled, so the semaphore is given once per burst instead of per pulse.
+ */
+void timer_stress_pulse_from_isr(void) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if (++stress_count != timer_stress_target) {
+        return;
+    }
+
+    stress_end_cycles = tim7_isr_cycles;
+    __HAL_TIM_DISABLE_IT(&htim7, TIM_IT_UPDATE);
+
+    xSemaphoreGiveFromISR(TimSemHandle, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief PWM output to input-capture loopback test.
+ * * The bit pattern carries a timer_pwm_config_t. Each iteration captures
+ * TIMER_PWM_DISCARD + periods CCR1/CCR2 pairs; the first pairs are dropped
+ * since they span the capture start-up, and the rest are summed to give the
+ * measured frequency and duty cycle over all periods.
+ * * @param command Pointer to the test_command_t structure.
+ * @param report Receives a timer_pwm_report_t summary.
+ * @return Result TEST_PASS if frequency and duty are within limits,
+ * TEST_FAIL on timeout or out-of-limit readings, TEST_ERR for null input or an invalid configuration.
+ */
+Result timer_pwm_testing(test_command_t* command, test_report_t* report) {
+    timer_pwm_report_t summary = {0};
+    timer_pwm_config_t config = {0};
+    uint32_t capture_clock, timeout_ms, frequency_error, duty_error, period;
+    uint64_t period_sum, high_sum, expected_mhz;
+    Result result = TEST_PASS;
+
+    if (command == NULL || report == NULL) {
+        return TEST_ERR;
+    }
+
+    if (command->bit_pattern_length >= sizeof(config)) {
+        memcpy(&config, command->bit_pattern, sizeof(config));
+    }
+    if (config.periods == 0) {
+        config.periods = TIMER_PWM_DEFAULT_PERIODS;
+    }
+    if (config.max_frequency_error_ppm == 0) {
+        config.max_frequency_error_ppm = TIMER_PWM_MAX_FREQUENCY_ERROR_PPM;
+    }
+    if (config.max_duty_error == 0) {
+        config.max_duty_error = TIMER_PWM_MAX_DUTY_ERROR;
+    }
+    // 0% and 100% duty have no edges to capture
+    if (config.frequency_hz == 0 || config.frequency_hz > TIMER_PWM_MAX_FREQUENCY_HZ ||
+        config.duty == 0 || config.duty >= TIMER_PWM_DUTY_SCALE ||
+        config.periods > TIMER_PWM_MAX_PERIODS) {
+        return TEST_ERR;
+    }
+
+    if (timer_pwm_init() != HAL_OK || timer_pwm_configure(&config) != HAL_OK) {
+        timer_pwm_stop();
+        return TEST_FAIL;
+    }
+
+    capture_clock = timer_apb2_clock() / (htim1.Init.Prescaler + 1U);
+    summary.generated_frequency_mhz = (uint32_t)(((uint64_t)timer_apb1_clock() * 1000U) /
+                                      ((htim3.Init.Prescaler + 1U) * (htim3.Init.Period + 1U)));
+    summary.generated_duty = (uint16_t)((__HAL_TIM_GET_COMPARE(&htim3, TIM_CHANNEL_1) * TIMER_PWM_DUTY_SCALE) /
+                                        (htim3.Init.Period + 1U));
+    summary.periods = config.periods;
+    summary.min_period_ticks = UINT16_MAX;
+
+    // Twice the nominal capture time, plus scheduling margin
+    timeout_ms = (uint32_t)(((uint64_t)(config.periods + TIMER_PWM_DISCARD) * 2000U) / config.frequency_hz) + 100U;
+
+    if (HAL_TIM_PWM_Start(&htim3, TIM_CHANNEL_1) != HAL_OK) {
+        timer_pwm_stop();
+        return TEST_FAIL;
+    }
+
+    for (uint8_t i = 0; i < command->iterations; i++) {
+        if (test_checkpoint(i)) {
+            result = TEST_ABORTED;
+            break;
+        }
+        xSemaphoreTake(TimSemHandle, 0);
+        SCB_InvalidateDCache_by_Addr((uint32_t*)pwm_capture, CACHE_ROUND(sizeof(pwm_capture)));
+
+        if (HAL_TIM_DMABurst_MultiReadStart(&htim1, TIM_DMABASE_CCR1, TIM_DMA_CC1, (uint32_t*)pwm_capture,
+                                            TIM_DMABURSTLENGTH_2TRANSFERS,
+                                            2U * (config.periods + TIMER_PWM_DISCARD)) != HAL_OK ||
+            HAL_TIM_IC_Start(&htim1, TIM_CHANNEL_1) != HAL_OK ||
+            HAL_TIM_IC_Start(&htim1, TIM_CHANNEL_2) != HAL_OK) {
+            result = TEST_FAIL;
+            break;
+        }
+
+        if (test_wait(TimSemHandle, pdMS_TO_TICKS(timeout_ms)) != pdPASS) {
+            result = TEST_FAIL;
+            break;
+        }
+        HAL_TIM_DMABurst_ReadStop(&htim1, TIM_DMA_CC1);
+        HAL_TIM_IC_Stop(&htim1, TIM_CHANNEL_2);
+        HAL_TIM_IC_Stop(&htim1, TIM_CHANNEL_1);
+        SCB_InvalidateDCache_by_Addr((uint32_t*)pwm_capture, CACHE_ROUND(sizeof(pwm_capture)));
+
+        // CCR1 = rising-to-rising period, CCR2 = rising-to-falling high time
+        period_sum = 0;
+        high_sum = 0;
+        for (uint32_t p = TIMER_PWM_DISCARD; p < config.periods + TIMER_PWM_DISCARD; p++) {
+            period = pwm_capture[2U * p];
+            if (period < summary.min_period_ticks) {
+                summary.min_period_ticks = (uint16_t)period;
+            }
+            if (period > summary.max_period_ticks) {
+                summary.max_period_ticks = (uint16_t)period;
+            }
+            period_sum += period;
+            high_sum += pwm_capture[2U * p + 1U];
+        }
+        if (period_sum == 0) {
+            result = TEST_FAIL;
+            break;
+        }
+
+        summary.measured_frequency_mhz = (uint32_t)(((uint64_t)capture_clock * 1000U * config.periods) / period_sum);
+        summary.measured_duty = (uint16_t)((high_sum * TIMER_PWM_DUTY_SCALE) / period_sum);
+
+        // Errors against the commanded values, so generator rounding is included
+        expected_mhz = (uint64_t)config.frequency_hz * 1000U;
+        frequency_error = (uint32_t)((((summary.measured_frequency_mhz > expected_mhz) ?
+                                       summary.measured_frequency_mhz - expected_mhz :
+                                       expected_mhz - summary.measured_frequency_mhz) * 1000000U) / expected_mhz);
+        duty_error = (summary.measured_duty > config.duty) ? summary.measured_duty - config.duty
+                                                           : config.duty - summary.measured_duty;
+        if (frequency_error > summary.max_frequency_error_ppm) {
+            summary.max_frequency_error_ppm = frequency_error;
+        }
+        if (duty_error > summary.max_duty_error) {
+            summary.max_duty_error = (uint16_t)duty_error;
+        }
+        summary.runs++;
+
+        if (frequency_error > config.max_frequency_error_ppm || duty_error > config.max_duty_error) {
+            result = TEST_FAIL;
+        }
+    }
+
+    timer_pwm_stop();
+
+    if (summary.runs == 0) {
+        summary.min_period_ticks = 0;
+    }
+
+    memcpy(report->data, &summary, sizeof(summary));
+    report->length = sizeof(summary);
+
+    return result;
+}
+
+/**
+ * @brief Capture DMA complete callback, signals the end of a PWM capture.
+ */
+void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if (htim->Instance == TIM1) {
+        xSemaphoreGiveFromISR(TimSemHandle, &xHigherPriorityTaskWoken);
+        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    }
+}
+
+/**
+ * @brief Returns the kernel clock of the APB2 timers (TIM1, TIM8-11).
+ * * APB2 timers run at twice PCLK2 when the APB2 prescaler is not 1.
+ */
+uint32_t timer_apb2_clock(void) {
+    uint32_t timer_clock = HAL_RCC_GetPCLK2Freq();
+
+    if ((RCC->CFGR & RCC_CFGR_PPRE2) != RCC_CFGR_PPRE2_DIV1) {
+        timer_clock *= 2U;
+    }
+    return timer_clock;
+}
+
+/**
+ * @brief Returns the kernel clock of the APB1 timers (TIM2-7, TIM12-14).
+ * * APB1 timers run at twice PCLK1 when the APB1 prescaler is not 1.
+ */
+uint32_t timer_apb1_clock(void) {
+    uint32_t timer_clock = HAL_RCC_GetPCLK1Freq();
+
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_HCLK_DIV1) {
+        timer_clock *= 2U;
+    }
+    return timer_clock;
+}
+
+/**
+ * @brief Reprograms TIM7 from the stress configuration.
+ * * A frequency is turned into the smallest prescaler that lets the period fit
+ * in 16 bits; otherwise the explicit prescaler/period are used as given.
+ */
+static HAL_StatusTypeDef timer_stress_configure(const timer_stress_config_t* config) {
+    uint32_t ticks;
+
+    if (config->frequency_hz != 0) {
+        ticks = timer_apb1_clock() / config->frequency_hz;
+        if (ticks < 2U) {
+            return HAL_ERROR;
+        }
+        htim7.Init.Prescaler = (ticks - 1U) / 65536U;
+        htim7.Init.Period = ticks / (htim7.Init.Prescaler + 1U) - 1U;
+    }
+    else {
+        htim7.Init.Prescaler = config->prescaler;
+        htim7.Init.Period = config->period;
+    }
+
+    return HAL_TIM_Base_Init(&htim7);
+}
+
+/**
+ * @brief One-time setup of the loopback pins, timer clocks and the capture DMA stream.
+ */
+static HAL_StatusTypeDef timer_pwm_init(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    if (hdma_tim1_ch1.Instance != NULL) {
+        return HAL_OK;
+    }
+
+    __HAL_RCC_TIM1_CLK_ENABLE();
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    __HAL_RCC_GPIOE_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    // PC6 -> TIM3_CH1 (PWM output)
+    GPIO_InitStruct.Pin = GPIO_PIN_6;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Alternate = GPIO_AF2_TIM3;
+    HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+    // PE9 -> TIM1_CH1 (capture input)
+    GPIO_InitStruct.Pin = GPIO_PIN_9;
+    GPIO_InitStruct.Pull = GPIO_PULLDOWN;
+    GPIO_InitStruct.Alternate = GPIO_AF1_TIM1;
+    HAL_GPIO_Init(GPIOE, &GPIO_InitStruct);
+
+    // TIM1 DMAR -> memory, one CCR1/CCR2 burst per captured period
+    hdma_tim1_ch1.Instance = DMA2_Stream6;
+    hdma_tim1_ch1.Init.Channel = DMA_CHANNEL_0;
+    hdma_tim1_ch1.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_tim1_ch1.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_tim1_ch1.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_tim1_ch1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_tim1_ch1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_tim1_ch1.Init.Mode = DMA_NORMAL;
+    hdma_tim1_ch1.Init.Priority = DMA_PRIORITY_HIGH;
+    hdma_tim1_ch1.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_tim1_ch1) != HAL_OK) {
+        hdma_tim1_ch1.Instance = NULL;
+        return HAL_ERROR;
+    }
+    __HAL_LINKDMA(&htim1, hdma[TIM_DMA_ID_CC1], hdma_tim1_ch1);
+
+    HAL_NVIC_SetPriority(DMA2_Stream6_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream6_IRQn);
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Programs the TIM3 generator and the TIM1 PWM-input capture for the commanded signal.
+ * * Both timers use the smallest prescaler that keeps one period within 16 bits,
+ * giving the finest duty resolution and capture precision.
+ */
+static HAL_StatusTypeDef timer_pwm_configure(const timer_pwm_config_t* config) {
+    TIM_OC_InitTypeDef sConfigOC = {0};
+    TIM_IC_InitTypeDef sConfigIC = {0};
+    TIM_SlaveConfigTypeDef sSlaveConfig = {0};
+    uint32_t ticks;
+
+    // Generator
+    ticks = timer_apb1_clock() / config->frequency_hz;
+    if (ticks < 2U) {
+        return HAL_ERROR;
+    }
+    htim3.Instance = TIM3;
+    htim3.Init.Prescaler = (ticks - 1U) / 65536U;
+    htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim3.Init.Period = ticks / (htim3.Init.Prescaler + 1U) - 1U;
+    htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    if (HAL_TIM_PWM_Init(&htim3) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    sConfigOC.OCMode = TIM_OCMODE_PWM1;
+    sConfigOC.Pulse = (uint32_t)(((uint64_t)(htim3.Init.Period + 1U) * config->duty) / TIMER_PWM_DUTY_SCALE);
+    sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+    sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+    if (HAL_TIM_PWM_ConfigChannel(&htim3, &sConfigOC, TIM_CHANNEL_1) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    // Capture: the counter restarts on each rising edge, CCR1 latches the period, CCR2 the high time
+    ticks = timer_apb2_clock() / config->frequency_hz;
+    htim1.Instance = TIM1;
+    htim1.Init.Prescaler = ticks / TIMER_PWM_CAPTURE_MAX_TICKS;
+    htim1.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim1.Init.Period = 0xFFFF;
+    htim1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim1.Init.RepetitionCounter = 0;
+    htim1.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_IC_Init(&htim1) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_RISING;
+    sConfigIC.ICSelection = TIM_ICSELECTION_DIRECTTI;
+    sConfigIC.ICPrescaler = TIM_ICPSC_DIV1;
+    sConfigIC.ICFilter = 0;
+    if (HAL_TIM_IC_ConfigChannel(&htim1, &sConfigIC, TIM_CHANNEL_1) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    sConfigIC.ICPolarity = TIM_INPUTCHANNELPOLARITY_FALLING;
+    sConfigIC.ICSelection = TIM_ICSELECTION_INDIRECTTI;
+    if (HAL_TIM_IC_ConfigChannel(&htim1, &sConfigIC, TIM_CHANNEL_2) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    sSlaveConfig.SlaveMode = TIM_SLAVEMODE_RESET;
+    sSlaveConfig.InputTrigger = TIM_TS_TI1FP1;
+    sSlaveConfig.TriggerPolarity = TIM_TRIGGERPOLARITY_RISING;
+    sSlaveConfig.TriggerFilter = 0;
+    return HAL_TIM_SlaveConfigSynchro(&htim1, &sSlaveConfig);
+}
+
+/**
+ * @brief Stops the generator and any capture in progress.
+ */
+static void timer_pwm_stop(void) {
+    if (htim1.Instance != NULL) {
+        HAL_TIM_DMABurst_ReadStop(&htim1, TIM_DMA_CC1);
+        HAL_TIM_IC_Stop(&htim1, TIM_CHANNEL_2);
+        HAL_TIM_IC_Stop(&htim1, TIM_CHANNEL_1);
+    }
+    if (htim3.Instance != NULL) {
+        HAL_TIM_PWM_Stop(&htim3, TIM_CHANNEL_1);
+    }
+}
+
+/**
+ * @brief Enables the DWT cycle counter, if it is not running already.
+ */
+void dwt_cycle_counter_init(void) {
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) != 0) {
+        return;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55;  // Unlock the DWT registers (Cortex-M7)
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * @brief Takes the test limits from the bit pattern, falling back to the defaults.
+ * * Only TIMER_LIMITS carries them, a plain TIMER pattern is not limits.
+ * A zero field, or a pattern shorter than timer_limits_t, keeps the default.
+ */
+static void timer_limits_from_command(const test_command_t* command, timer_limits_t* limits) {
+    timer_limits_t requested = {0};
+
+    limits->max_period_error_ppm = TIMER_MAX_PERIOD_ERROR_PPM;
+    limits->max_jitter_us = TIMER_MAX_JITTER_US;
+    limits->max_latency_us = TIMER_MAX_LATENCY_US;
+
+    if (command->peripheral != TIMER_LIMITS || command->bit_pattern_length < sizeof(timer_limits_t)) {
+        return;
+    }
+    memcpy(&requested, command->bit_pattern, sizeof(requested));
+
+    if (requested.max_period_error_ppm != 0) {
+        limits->max_period_error_ppm = requested.max_period_error_ppm;
+    }
+    if (requested.max_jitter_us != 0) {
+        limits->max_jitter_us = requested.max_jitter_us;
+    }
+    if (requested.max_latency_us != 0) {
+        limits->max_latency_us = requested.max_latency_us;
+    }
+}
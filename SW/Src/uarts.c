@@ -12,6 +12,8 @@
 #define UART_SENDER         (&huart2)
 #define UART_RECEIVER       (&huart4)
 
+static Result uart_loopback(test_command_t* command, uint8_t* tx_buffer, uint8_t* rx_buffer, uint8_t* echo_buffer);
+
 /**
  * @brief Performs a hardware verification test on the UART peripherals.
  * * This test transmits a bit pattern from UART2 to UART4 using DMA.
@@ -22,21 +24,65 @@
  */
 Result uart_testing(test_command_t* command){
 
-    uint8_t tx_buffer[MAX_BIT_PATTERN_LENGTH] = {0};
-    uint8_t rx_buffer[MAX_BIT_PATTERN_LENGTH] = {0};
-    uint8_t echo_buffer[MAX_BIT_PATTERN_LENGTH] = {0};
-
-    HAL_StatusTypeDef status;
+    dma_arena_mark_t mark;
+    uint8_t* tx_buffer;
+    uint8_t* rx_buffer;
+    uint8_t* echo_buffer;
+    Result result;
 
     if (command == NULL) {
         return TEST_ERR;
     }
 
+    // DMA-safe buffers leased from the shared arena for the duration of the test
+    mark = dma_arena_mark();
+    tx_buffer = dma_arena_lease(command->bit_pattern_length);
+    rx_buffer = dma_arena_lease(command->bit_pattern_length);
+    echo_buffer = dma_arena_lease(command->bit_pattern_length);
+
+    if (tx_buffer == NULL || rx_buffer == NULL || echo_buffer == NULL) {
+        result = TEST_FAIL;
+    }
+    else {
+        result = uart_loopback(command, tx_buffer, rx_buffer, echo_buffer);
+    }
+
+    dma_arena_release(mark);
+    return result;
+}
+
+/**
+ * @brief Runs the loopback iterations on leased buffers.
+ * @param command Pointer to the test_command_t structure.
+ * @param tx_buffer Pattern sent by UART2.
+ * @param rx_buffer Echo received back by UART2.
+ * @param echo_buffer Pattern received by UART4 and echoed.
+ */
+static Result uart_loopback(test_command_t* command, uint8_t* tx_buffer, uint8_t* rx_buffer, uint8_t* echo_buffer) {
+
+    HAL_StatusTypeDef status;
+    crc_stream_t stream;
+
     // Prepare the transmission pattern
     memcpy(tx_buffer, command->bit_pattern, command->bit_pattern_length);
+    dma_buffer_clean(tx_buffer, command->bit_pattern_length);
+
+    // Large patterns: digest TX once, then only the received data is CRC'd per iteration
+    if (command->bit_pattern_length > 100 &&
+        crc_stream_begin(&stream, tx_buffer, command->bit_pattern_length) != HAL_OK) {
+        return TEST_FAIL;
+    }
 
     for(uint8_t i=0 ; i < command->iterations ; i++){
+        if (test_checkpoint(i)) {
+            return TEST_ABORTED;
+        }
         memset(rx_buffer, 0, command->bit_pattern_length);
+        dma_buffer_invalidate(echo_buffer, command->bit_pattern_length);
+
+        // Drain stale completions, an aborted test may have left one
+        xSemaphoreTake(UartTxHandle, 0);
+        xSemaphoreTake(UartRxHandle, 0);
 
         // --- 1. Prepare Receiver to receive the pattern (DMA Mode) ---
         status = HAL_UART_Receive_DMA(UART_RECEIVER, echo_buffer, command->bit_pattern_length);
@@ -58,12 +104,14 @@ Result uart_testing(test_command_t* command){
         }
 
         // Wait for Receiver to finish collecting the pattern via DMA
-        if (xSemaphoreTake(UartTxHandle, TIMEOUT) != pdPASS) {
+        if (test_wait(UartTxHandle, TIMEOUT) != pdPASS) {
              HAL_UART_Abort(UART_RECEIVER);
              HAL_UART_Abort(UART_SENDER);
              return TEST_FAIL;
         }
 
+        dma_buffer_invalidate(echo_buffer, command->bit_pattern_length);
+
         // --- 4. Echo Phase: Receiver transmits collected data back ---
         if (HAL_UART_Transmit_IT(UART_RECEIVER, echo_buffer, command->bit_pattern_length) != HAL_OK){
              HAL_UART_Abort(UART_RECEIVER);
@@ -72,7 +120,7 @@ Result uart_testing(test_command_t* command){
         }
 
         // Wait for Sender to finish receiving the echoed data
-        if (xSemaphoreTake(UartRxHandle, TIMEOUT) != pdPASS) {
+        if (test_wait(UartRxHandle, TIMEOUT) != pdPASS) {
             HAL_UART_Abort(UART_SENDER);
             HAL_UART_Abort(UART_RECEIVER);
             return TEST_FAIL;
@@ -80,10 +128,8 @@ Result uart_testing(test_command_t* command){
 
         // --- 5. Data Validation ---
         if (command->bit_pattern_length > 100) {
-            // CRC comparison for efficiency on large data sets
-            uint32_t sent_crc = calculate_crc(tx_buffer, command->bit_pattern_length);
-            uint32_t received_crc = calculate_crc(rx_buffer, command->bit_pattern_length);
-            if (sent_crc != received_crc) {
+            // Running CRC over everything received, checked against the TX digest chain
+            if (!crc_stream_check(&stream, rx_buffer, command->bit_pattern_length)) {
                 return TEST_FAIL;
             }
         }
@@ -0,0 +1,36 @@
+/*
+ * Host stand-in for FreeRTOS.h, just enough to build the firmware heaps
+ * (heap_4.c and SW/Src/heap_tlsf.c) natively for heap_bench.
+ */
+#ifndef HEAP_BENCH_FREERTOS_H
+#define HEAP_BENCH_FREERTOS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#define configSUPPORT_DYNAMIC_ALLOCATION    1
+#define configAPPLICATION_ALLOCATED_HEAP    0
+#define configUSE_MALLOC_FAILED_HOOK        0
+#define configTOTAL_HEAP_SIZE               ((size_t)102400)   /* Same as the board */
+
+#define portBYTE_ALIGNMENT                  8
+#define portBYTE_ALIGNMENT_MASK             (0x0007)
+#define portPOINTER_SIZE_TYPE               uintptr_t
+
+#define configASSERT(x)                     assert(x)
+#define mtCOVERAGE_TEST_MARKER()
+#define traceMALLOC(p, size)
+#define traceFREE(p, size)
+
+typedef long BaseType_t;
+
+void* pvPortMalloc(size_t xWantedSize);
+void vPortFree(void* pv);
+size_t xPortGetFreeHeapSize(void);
+size_t xPortGetMinimumEverFreeHeapSize(void);
+void vPortInitialiseBlocks(void);
+
+uint32_t bench_cycles(void);    /* HEAP_CYCLE_COUNT for heap_tlsf.c */
+
+#endif
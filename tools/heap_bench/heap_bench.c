@@ -0,0 +1,180 @@
+/**
+ * @file heap_bench.c
+ * @brief Host stress benchmark: heap_tlsf.c against FreeRTOS heap_4.c.
+ * * Both heaps are built natively from the firmware sources, with the local
+ * FreeRTOS.h/task.h stand-ins, and run the same pseudo-random workload of
+ * command-buffer sized and stack sized allocations with random frees. The
+ * benchmark reports mean and worst-case latency per call, failed allocations
+ * and the largest free block left once the workload has fragmented the heap.
+ * * Build and run from the repository root:
+ *   gcc -O2 -I tools/heap_bench -I SW/Inc -DHEAP_CYCLE_COUNT=bench_cycles \
+ *       -D"pvPortMalloc=heap4_malloc" -D"vPortFree=heap4_free" \
+ *       -D"xPortGetFreeHeapSize=heap4_free_size" -D"xPortGetMinimumEverFreeHeapSize=heap4_min_free" \
+ *       -D"vPortInitialiseBlocks=heap4_init_blocks" \
+ *       -c Middlewares/Third_Party/FreeRTOS/Source/portable/MemMang/heap_4.c -o /tmp/heap_4.o
+ *   gcc -O2 -I tools/heap_bench -I SW/Inc -DHEAP_CYCLE_COUNT=bench_cycles \
+ *       SW/Src/heap_tlsf.c tools/heap_bench/heap_bench.c /tmp/heap_4.o -o /tmp/heap_bench
+ *   /tmp/heap_bench [operations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "heap_tlsf.h"
+
+#define SLOTS       256         // Live allocations tracked by the workload
+#define OPERATIONS  2000000UL   // Default number of malloc/free calls
+
+void* heap4_malloc(size_t size);
+void heap4_free(void* p);
+size_t heap4_free_size(void);
+
+typedef struct heap_api_t {
+    const char* name;
+    void* (*alloc)(size_t);
+    void (*release)(void*);
+    size_t (*free_size)(void);
+} heap_api_t;
+
+typedef struct bench_result_t {
+    uint64_t alloc_ns_sum;
+    uint64_t free_ns_sum;
+    uint64_t alloc_ns_max;
+    uint64_t free_ns_max;
+    unsigned long allocs;
+    unsigned long frees;
+    unsigned long failures;
+} bench_result_t;
+
+/* Cycle source for heap_tlsf's own statistics (not used for the comparison) */
+uint32_t bench_cycles(void) {
+    return 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Allocation size mix: mostly test commands (~263 B) and small
+ * objects, sometimes task-stack sized blocks.
+ */
+static size_t pick_size(void) {
+    int r = rand() % 100;
+
+    if (r < 50) {
+        return 8 + (size_t)(rand() % 120);
+    }
+    if (r < 85) {
+        return 263;
+    }
+    if (r < 97) {
+        return 512 + (size_t)(rand() % 1536);
+    }
+    return 4096 + (size_t)(rand() % 4096);
+}
+
+/**
+ * @brief Largest block the heap can still hand out, found by bisection.
+ */
+static size_t largest_block(const heap_api_t* heap) {
+    size_t low = 0, high = configTOTAL_HEAP_SIZE;
+
+    while (low < high) {
+        size_t mid = (low + high + 1) / 2;
+        void* p = heap->alloc(mid);
+        if (p != NULL) {
+            heap->release(p);
+            low = mid;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+static void run(const heap_api_t* heap, unsigned long operations, unsigned seed) {
+    void* slots[SLOTS] = {0};
+    bench_result_t result = {0};
+    size_t largest;
+
+    srand(seed);
+
+    for (unsigned long i = 0; i < operations; i++) {
+        int slot = rand() % SLOTS;
+        uint64_t start, elapsed;
+
+        if (slots[slot] == NULL) {
+            size_t size = pick_size();
+            start = now_ns();
+            slots[slot] = heap->alloc(size);
+            elapsed = now_ns() - start;
+            result.alloc_ns_sum += elapsed;
+            if (elapsed > result.alloc_ns_max) {
+                result.alloc_ns_max = elapsed;
+            }
+            if (slots[slot] == NULL) {
+                result.failures++;
+            }
+            else {
+                memset(slots[slot], 0xA5, size);
+                result.allocs++;
+            }
+        }
+        else {
+            start = now_ns();
+            heap->release(slots[slot]);
+            elapsed = now_ns() - start;
+            result.free_ns_sum += elapsed;
+            if (elapsed > result.free_ns_max) {
+                result.free_ns_max = elapsed;
+            }
+            slots[slot] = NULL;
+            result.frees++;
+        }
+    }
+
+    largest = largest_block(heap);
+
+    printf("%-10s alloc avg %6.1f ns max %8llu ns | free avg %6.1f ns max %8llu ns | "
+           "failed %6lu | free %6zu B, largest %6zu B\n",
+           heap->name,
+           (double)result.alloc_ns_sum / (double)(result.allocs + result.failures),
+           (unsigned long long)result.alloc_ns_max,
+           (double)result.free_ns_sum / (double)result.frees,
+           (unsigned long long)result.free_ns_max,
+           result.failures, heap->free_size(), largest);
+
+    for (int s = 0; s < SLOTS; s++) {
+        heap->release(slots[s]);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long operations = (argc > 1) ? strtoul(argv[1], NULL, 0) : OPERATIONS;
+    unsigned seed = (argc > 2) ? (unsigned)strtoul(argv[2], NULL, 0) : 1U;
+    const heap_api_t heaps[] = {
+        { "heap_4", heap4_malloc, heap4_free, heap4_free_size },
+        { "heap_tlsf", pvPortMalloc, vPortFree, xPortGetFreeHeapSize },
+    };
+    heap_stats_t stats;
+
+    printf("%lu operations, seed %u, %zu byte heap\n", operations, seed, (size_t)configTOTAL_HEAP_SIZE);
+    for (size_t h = 0; h < sizeof(heaps) / sizeof(heaps[0]); h++) {
+        run(&heaps[h], operations, seed);
+    }
+
+    heap_get_stats(&stats);
+    printf("heap_tlsf stats: free %u B, min ever %u B, largest %u B, fragmentation %u/1000, "
+           "%u allocs, %u frees, %u failures\n",
+           stats.free_bytes, stats.min_ever_free_bytes, stats.largest_free_block,
+           stats.fragmentation_permille, stats.allocations, stats.frees, stats.failures);
+    return 0;
+}
@@ -0,0 +1,8 @@
+/* Host stand-in for task.h: the benchmark is single threaded */
+#ifndef HEAP_BENCH_TASK_H
+#define HEAP_BENCH_TASK_H
+
+#define vTaskSuspendAll()
+#define xTaskResumeAll()    0
+
+#endif
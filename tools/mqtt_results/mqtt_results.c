@@ -0,0 +1,111 @@
+/**
+ * @file mqtt_results.c
+ * @brief Host decoder for the board's MQTT telemetry.
+ * * Build and run from the repository root, with mosquitto as the broker
+ * at MQTT_BROKER_ADDR:
+ *   gcc -O2 -Wall -I SW/Inc tools/mqtt_results/mqtt_results.c -o /tmp/mqtt_results
+ *   mosquitto_sub -t 'hwtest/#' -F '%t %x' | /tmp/mqtt_results
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "project_header.h"
+
+#define MAX_LINE    4096
+
+static size_t from_hex(const char* hex, uint8_t* out, size_t size)
+{
+    size_t n = 0;
+    unsigned int byte;
+
+    while (n < size && sscanf(hex, "%2x", &byte) == 1) {
+        out[n++] = (uint8_t)byte;
+        hex += 2;
+    }
+    return n;
+}
+
+static void print_results(const char* topic, const uint8_t* payload, size_t length)
+{
+    mqtt_batch_header_t header;
+    mqtt_result_record_t record;
+    size_t at = sizeof(header);
+    unsigned int i, j;
+
+    if (length < sizeof(header)) {
+        fprintf(stderr, "%s: short batch\n", topic);
+        return;
+    }
+    memcpy(&header, payload, sizeof(header));
+    if (header.version != MQTT_BATCH_VERSION) {
+        fprintf(stderr, "%s: batch version %u\n", topic, header.version);
+        return;
+    }
+    if (header.dropped > 0) {
+        printf("%s: %u results dropped before this batch\n", topic, header.dropped);
+    }
+
+    for (i = 0; i < header.records; i++) {
+        if (at + sizeof(record) > length) {
+            fprintf(stderr, "%s: batch truncated at record %u\n", topic, i);
+            return;
+        }
+        memcpy(&record, payload + at, sizeof(record));
+        at += sizeof(record);
+        if (at + record.report_length > length) {
+            fprintf(stderr, "%s: report of test %u truncated\n", topic, record.test_id);
+            return;
+        }
+        printf("%s: test %u result %d", topic, record.test_id, record.test_result);
+        if (record.report_length > 0) {
+            printf(" report ");
+            for (j = 0; j < record.report_length; j++) {
+                printf("%02x", payload[at + j]);
+            }
+        }
+        printf("\n");
+        at += record.report_length;
+    }
+}
+
+static void print_metrics(const char* topic, const uint8_t* payload, size_t length)
+{
+    net_metrics_t m;
+
+    if (length != sizeof(m)) {
+        fprintf(stderr, "%s: %zu bytes, expected %zu\n", topic, length, sizeof(m));
+        return;
+    }
+    memcpy(&m, payload, sizeof(m));
+    printf("%s: uptime %u ms, link recv %u drop %u, udp recv %u, cmdq enqueued %u full %u, sessions %u\n",
+           topic, m.uptime_ms, m.link_recv, m.link_drop, m.udp_recv, m.cmdq_enqueued, m.cmdq_full,
+           m.sessions_active);
+}
+
+int main(void)
+{
+    static char line[MAX_LINE];
+    static uint8_t payload[MAX_LINE / 2];
+    char* hex;
+    size_t length, topic_length;
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        hex = strchr(line, ' ');
+        if (hex == NULL) {
+            continue;
+        }
+        *hex++ = '\0';
+        length = from_hex(hex, payload, sizeof(payload));
+        topic_length = strlen(line);
+
+        if (topic_length > 8 && strcmp(line + topic_length - 8, "/results") == 0) {
+            print_results(line, payload, length);
+        } else if (topic_length > 8 && strcmp(line + topic_length - 8, "/metrics") == 0) {
+            print_metrics(line, payload, length);
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
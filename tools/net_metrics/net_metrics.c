@@ -0,0 +1,178 @@
+/**
+ * @file net_metrics.c
+ * @brief Host poller for the NET_METRICS query.
+ * * Sends a NET_METRICS command to the board every interval, prints the
+ * counters of each snapshot as per-second rates over the board's own uptime
+ * and the level fields (pool use, queue depth) as they are. A command that
+ * went missing shows up as a rate in the stage that dropped it: link, ETH DMA,
+ * pbuf and heap, UDP or the executor queue.
+ * * Build and run from the repository root:
+ *   gcc -O2 -Wall -I SW/Inc tools/net_metrics/net_metrics.c -o /tmp/net_metrics
+ *   /tmp/net_metrics [board-ip] [interval-ms]
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "project_header.h"
+
+#define DEFAULT_BOARD_IP    "192.168.100.2"
+#define DEFAULT_INTERVAL_MS 1000
+#define REPLY_TIMEOUT_MS    500
+
+typedef struct counter_t {
+    const char* name;
+    size_t offset;
+    int is_rate;        // Cumulative counter shown per second, otherwise a level
+} counter_t;
+
+#define COUNTER(field, rate) { #field, offsetof(net_metrics_t, field), rate }
+
+static const counter_t counters[] = {
+    COUNTER(link_recv, 1),          COUNTER(link_xmit, 1),
+    COUNTER(link_drop, 1),          COUNTER(link_err, 1),
+    COUNTER(eth_rx_irqs, 1),        COUNTER(eth_rx_mac_drops, 1),
+    COUNTER(eth_rx_alloc_drops, 1), COUNTER(eth_tx_queued, 1),
+    COUNTER(eth_tx_drops, 1),       COUNTER(rx_pool_used, 0),
+    COUNTER(pbuf_ref_used, 0),      COUNTER(pbuf_ref_errors, 1),
+    COUNTER(pbuf_pool_used, 0),     COUNTER(pbuf_pool_errors, 1),
+    COUNTER(mem_used, 0),           COUNTER(mem_errors, 1),
+    COUNTER(udp_recv, 1),           COUNTER(udp_xmit, 1),
+    COUNTER(udp_drop, 1),           COUNTER(udp_errors, 1),
+    COUNTER(cmdq_enqueued, 1),      COUNTER(cmdq_full, 1),
+    COUNTER(cmdq_rejected, 1),      COUNTER(cmdq_depth, 0),
+    COUNTER(cmdq_depth_max, 0),     COUNTER(cmdq_quota, 1),
+    COUNTER(sessions_active, 0),    COUNTER(cache_replays, 1),
+    COUNTER(cache_coalesced, 1),
+};
+
+#define COUNTERS    (sizeof(counters) / sizeof(counters[0]))
+
+static uint32_t field(const net_metrics_t* m, const counter_t* c)
+{
+    uint32_t value;
+
+    memcpy(&value, (const uint8_t*)m + c->offset, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Sends one NET_METRICS command and waits for its snapshot.
+ * @return 0 on success, -1 on timeout or a malformed reply.
+ */
+static int poll_metrics(int sock, const struct sockaddr_in* board, uint32_t test_id, net_metrics_t* m)
+{
+    test_command_t cmd;
+    uint8_t reply[sizeof(result_wire_t) + MAX_REPORT_LENGTH];
+    result_wire_t result = {0};     // test_id 0 is never polled, a short first reply loops
+    ssize_t length;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.test_id = test_id;
+    cmd.peripheral = NET_METRICS;
+    cmd.iterations = 1;
+
+    if (sendto(sock, &cmd, sizeof(cmd), 0, (const struct sockaddr*)board, sizeof(*board)) != sizeof(cmd)) {
+        perror("sendto");
+        return -1;
+    }
+
+    // Skip late replies to earlier polls
+    do {
+        length = recv(sock, reply, sizeof(reply), 0);
+        if (length < 0) {
+            return -1;
+        }
+        if ((size_t)length < sizeof(result)) {
+            continue;
+        }
+        memcpy(&result, reply, sizeof(result));
+    } while (result.test_id != test_id);
+
+    if (result.test_result != TEST_PASS || (size_t)length < sizeof(result) + sizeof(*m)) {
+        fprintf(stderr, "test %u: bad reply, result %d, %zd bytes\n", test_id, (int)result.test_result, length);
+        return -1;
+    }
+    memcpy(m, reply + sizeof(result), sizeof(*m));
+    return 0;
+}
+
+static void print_sample(const net_metrics_t* now, const net_metrics_t* prev)
+{
+    uint32_t elapsed_ms = prev ? now->uptime_ms - prev->uptime_ms : 0;
+    size_t i;
+
+    printf("uptime %u.%03u s, link %s", now->uptime_ms / 1000, now->uptime_ms % 1000,
+           now->link_up ? "up" : "down");
+    if (elapsed_ms) {
+        printf(", rates over %u ms", elapsed_ms);
+    }
+    printf("\n");
+
+    for (i = 0; i < COUNTERS; i++) {
+        const counter_t* c = &counters[i];
+        uint32_t value = field(now, c);
+
+        if (c->is_rate && elapsed_ms) {
+            // Unsigned difference, correct across one wrap
+            uint32_t delta = value - field(prev, c);
+            printf("  %-20s %10u %10.1f/s\n", c->name, value, delta * 1000.0 / elapsed_ms);
+        } else {
+            printf("  %-20s %10u\n", c->name, value);
+        }
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    const char* board_ip = (argc > 1) ? argv[1] : DEFAULT_BOARD_IP;
+    long interval_ms = (argc > 2) ? strtol(argv[2], NULL, 0) : DEFAULT_INTERVAL_MS;
+    struct timeval timeout = { 0, REPLY_TIMEOUT_MS * 1000 };
+    struct sockaddr_in board;
+    net_metrics_t samples[2];
+    int have_prev = 0;
+    int current = 0;
+    uint32_t test_id = 1;
+    int sock;
+
+    memset(&board, 0, sizeof(board));
+    board.sin_family = AF_INET;
+    board.sin_port = htons(CLIENT_PORT);
+    if (inet_pton(AF_INET, board_ip, &board.sin_addr) != 1 || interval_ms <= 0) {
+        fprintf(stderr, "usage: %s [board-ip] [interval-ms]\n", argv[0]);
+        return 1;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0 || setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    for (;;) {
+        if (poll_metrics(sock, &board, test_id++, &samples[current]) == 0) {
+            // A reboot restarts the counters, start the rates over
+            if (have_prev && samples[current].uptime_ms < samples[!current].uptime_ms) {
+                have_prev = 0;
+            }
+            print_sample(&samples[current], have_prev ? &samples[!current] : NULL);
+            have_prev = 1;
+            current = !current;
+        } else {
+            fprintf(stderr, "no reply from %s\n", board_ip);
+        }
+        usleep(interval_ms * 1000);
+    }
+
+    close(sock);
+    return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file tcp_bench.c
+ * @brief Host throughput benchmark for the TCP command channel.
+ * * Build and run from the repository root:
+ *   gcc -O2 -Wall -I SW/Inc tools/tcp_bench/tcp_bench.c -o /tmp/tcp_bench
+ *   /tmp/tcp_bench [board-ip] [commands] [in-flight]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "project_header.h"
+
+#define DEFAULT_BOARD_IP    "192.168.100.2"
+#define DEFAULT_COMMANDS    10000
+#define DEFAULT_IN_FLIGHT   8
+#define MAX_IN_FLIGHT       256
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int read_exact(int sock, void* buffer, size_t length)
+{
+    uint8_t* p = buffer;
+
+    while (length > 0) {
+        ssize_t n = recv(sock, p, length, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+static int send_command(int sock, uint32_t test_id)
+{
+    uint8_t frame[TCP_FRAME_HEADER_LENGTH + TCP_COMMAND_MIN_LENGTH];
+    uint16_t length = TCP_COMMAND_MIN_LENGTH;
+    test_command_t cmd;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.test_id = test_id;
+    cmd.peripheral = BOOT_STATS;
+    cmd.iterations = 1;
+
+    memcpy(frame, &length, TCP_FRAME_HEADER_LENGTH);
+    memcpy(frame + TCP_FRAME_HEADER_LENGTH, &cmd, TCP_COMMAND_MIN_LENGTH);
+    return send(sock, frame, sizeof(frame), 0) == (ssize_t)sizeof(frame) ? 0 : -1;
+}
+
+/**
+ * @brief Reads one result frame.
+ * @return The result's test ID, or 0 on a broken stream.
+ */
+static uint32_t read_result(int sock)
+{
+    uint8_t payload[sizeof(result_wire_t) + MAX_REPORT_LENGTH];
+    result_wire_t result;
+    uint16_t length;
+
+    if (read_exact(sock, &length, sizeof(length)) != 0 || length < sizeof(result) || length > sizeof(payload)
+        || read_exact(sock, payload, length) != 0) {
+        return 0;
+    }
+    memcpy(&result, payload, sizeof(result));
+    if (result.test_result != TEST_PASS) {
+        fprintf(stderr, "test %u: result %d\n", result.test_id, (int)result.test_result);
+    }
+    return result.test_id;
+}
+
+int main(int argc, char** argv)
+{
+    const char* board_ip = (argc > 1) ? argv[1] : DEFAULT_BOARD_IP;
+    long commands = (argc > 2) ? strtol(argv[2], NULL, 0) : DEFAULT_COMMANDS;
+    long in_flight = (argc > 3) ? strtol(argv[3], NULL, 0) : DEFAULT_IN_FLIGHT;
+    static double sent_at[MAX_IN_FLIGHT];
+    struct sockaddr_in board;
+    double start, elapsed, rtt, rtt_total = 0, rtt_max = 0;
+    uint32_t next_send = 1, next_result = 1, id;
+    int one = 1;
+    int sock;
+
+    memset(&board, 0, sizeof(board));
+    board.sin_family = AF_INET;
+    board.sin_port = htons(TCP_COMMAND_PORT);
+    if (inet_pton(AF_INET, board_ip, &board.sin_addr) != 1 || commands <= 0
+        || in_flight <= 0 || in_flight > MAX_IN_FLIGHT) {
+        fprintf(stderr, "usage: %s [board-ip] [commands] [in-flight 1..%d]\n", argv[0], MAX_IN_FLIGHT);
+        return 1;
+    }
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0 || connect(sock, (struct sockaddr*)&board, sizeof(board)) != 0) {
+        perror("connect");
+        return 1;
+    }
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    start = now_us();
+    while (next_result <= (uint32_t)commands) {
+        // Keep the pipe full, then wait for the oldest result
+        while (next_send <= (uint32_t)commands && next_send - next_result < (uint32_t)in_flight) {
+            sent_at[next_send % MAX_IN_FLIGHT] = now_us();
+            if (send_command(sock, next_send) != 0) {
+                perror("send");
+                return 1;
+            }
+            next_send++;
+        }
+
+        id = read_result(sock);
+        if (id != next_result) {
+            fprintf(stderr, "expected result %u, got %u\n", next_result, id);
+            return 1;
+        }
+        rtt = now_us() - sent_at[id % MAX_IN_FLIGHT];
+        rtt_total += rtt;
+        if (rtt > rtt_max) {
+            rtt_max = rtt;
+        }
+        next_result++;
+    }
+    elapsed = now_us() - start;
+
+    printf("%ld commands, %ld in flight: %.0f commands/s, round trip mean %.0f us, max %.0f us\n",
+           commands, in_flight, commands * 1e6 / elapsed, rtt_total / commands, rtt_max);
+    close(sock);
+    return 0;
+}